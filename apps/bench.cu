@@ -0,0 +1,349 @@
+#include <groot.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <iterator>
+#include <set>
+#include <sstream>
+
+using namespace groot;
+
+// Per-stage benchmark on synthetic matrices, written as CSV rows:
+//   generator,mode,threads,rows,cols,nnz,stage,repeat,ms
+// Strong scaling keeps the size fixed across thread counts; weak scaling (-w) multiplies the number of
+// rows by the thread count. -c instead checks the two implementations of the `blocks` KNN metric
+// (BlockOracle and block_distance) against a brute-force count on the same matrices, and exits.
+
+struct BenchConfig {
+    std::vector<std::string> generators   = {"rmat", "er", "banded", "block", "dup"};
+    std::vector<int>         scales       = {12, 14};  // log2 of the number of rows
+    std::vector<int>         threads      = {1, omp_get_max_threads()};
+    int                      degree       = 16;
+    int                      repeats      = 3;
+    unsigned                 knn_k        = 16;
+    bool                     weak_scaling = false;
+    bool                     check_blocks = false;
+    std::string              output_file  = "groot_bench.csv";
+    std::string              temp_dir     = std::filesystem::temp_directory_path();
+};
+
+std::string bench_hints =
+    "              [-g generators (default: rmat,er,banded,block,dup)]\n"
+    "              [-s log2_rows (default: 12,14)]\n"
+    "              [-t threads (default: 1,max)]\n"
+    "              [-d average_degree (default: 16)]\n"
+    "              [-r repeats (default: 3)]\n"
+    "              [-k knn_neighbors (default: 16)]\n"
+    "              [-w (weak scaling: rows x threads)]\n"
+    "              [-c (check the blocks KNN metric against brute force, no timing)]\n"
+    "              [-o output_csv (default: groot_bench.csv)]\n"
+    "              [-T temp_dir]\n";
+
+std::vector<std::string> split_list(const std::string& text)
+{
+    std::vector<std::string> items;
+    std::stringstream        stream(text);
+    for (std::string item; std::getline(stream, item, ',');) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+std::vector<int> split_ints(const std::string& text)
+{
+    std::vector<int> values;
+    for (const auto& item : split_list(text)) {
+        values.push_back(std::stoi(item));
+    }
+    return values;
+}
+
+BenchConfig bench_options(int argc, char* argv[])
+{
+    BenchConfig config;
+    int         opt;
+    while ((opt = getopt(argc, argv, "g:s:t:d:r:k:wco:T:h")) != -1) {
+        switch (opt) {
+            case 'g':
+                config.generators = split_list(optarg);
+                break;
+            case 's':
+                config.scales = split_ints(optarg);
+                break;
+            case 't':
+                config.threads = split_ints(optarg);
+                break;
+            case 'd':
+                config.degree = std::stoi(optarg);
+                break;
+            case 'r':
+                config.repeats = std::stoi(optarg);
+                break;
+            case 'k':
+                config.knn_k = std::stoi(optarg);
+                break;
+            case 'w':
+                config.weak_scaling = true;
+                break;
+            case 'c':
+                config.check_blocks = true;
+                break;
+            case 'o':
+                config.output_file = optarg;
+                break;
+            case 'T':
+                config.temp_dir = optarg;
+                break;
+            default:
+                printf("Usage: %s ... \n%s", argv[0], bench_hints.c_str());
+                exit(EXIT_FAILURE);
+        }
+    }
+    return config;
+}
+
+template<typename CsrMatrix>
+bool generate(CsrMatrix& mat, const std::string& name, int64_t rows, int degree, uint64_t seed)
+{
+    if (name == "rmat") {
+        generate_rmat(mat, std::ilogb(double(rows)), degree, 0.57, 0.19, 0.19, seed);
+    }
+    else if (name == "er") {
+        generate_erdos_renyi(mat, rows, rows, degree, seed);
+    }
+    else if (name == "banded") {
+        generate_banded(mat, rows, degree / 2, 1.0, seed);
+    }
+    else if (name == "block") {
+        generate_block_diagonal(mat, rows, 4 * degree, 0.2, 0.1 * degree, seed);
+    }
+    else if (name == "dup") {
+        // rows are random already; permute_csr_cpu would also drop the duplicates
+        generate_duplicate_heavy(mat, rows, degree, 4, seed);
+        return true;
+    }
+    else {
+        return false;
+    }
+    // the natural order of the generators is (close to) ideal, hide it
+    thrust::host_vector<int> perm;
+    random_permutation(perm, mat.num_rows, seed);
+    permute_csr_cpu(mat, perm);
+    return true;
+}
+
+// Blocks touched by only one of two rows, from the sets of blocks themselves
+unsigned brute_force_block_distance(const std::vector<int>& a, const std::vector<int>& b, unsigned block_cols)
+{
+    std::set<unsigned> x, y;
+    for (const auto c : a) {
+        x.insert(unsigned(c) / block_cols);
+    }
+    for (const auto c : b) {
+        y.insert(unsigned(c) / block_cols);
+    }
+    std::vector<unsigned> only;
+    std::set_symmetric_difference(x.begin(), x.end(), y.begin(), y.end(), std::back_inserter(only));
+    return only.size();
+}
+
+// BlockOracle and block_distance against the brute force, for every row paired with itself, its successor
+// and a pseudo-random partner; returns the number of mismatches
+template<typename CsrMatrix>
+size_t check_block_distances(const CsrMatrix& mat, unsigned block_cols)
+{
+    AdjVector<int> adj;
+    convert_csr_to_adj(mat, adj);
+    const BlockOracle oracle(adj, block_cols, nullptr);
+    const int64_t     nrow       = adj.size();
+    size_t            mismatches = 0;
+#pragma omp parallel for reduction(+ : mismatches)
+    for (int64_t i = 0; i < nrow; i++) {
+        for (const int64_t j : {i, (i + 1) % nrow, (i * 7919 + 13) % nrow}) {
+            const auto& a        = adj[i];
+            const auto& b        = adj[j];
+            const float expected = brute_force_block_distance(a, b, block_cols);
+            const float merged   = block_distance(a.data(), a.size(), b.data(), b.size(), block_cols);
+            if (oracle(i, j) != expected || merged != expected) {
+                mismatches++;
+            }
+        }
+    }
+    return mismatches;
+}
+
+int main(int argc, char** argv)
+{
+    using HostCsr = CsrMatrix<int, float, host_memory>;
+
+    const BenchConfig config = bench_options(argc, argv);
+
+    if (config.check_blocks) {
+        size_t failures = 0;
+        for (const auto& generator : config.generators) {
+            for (const int scale : config.scales) {
+                HostCsr mat;
+                if (!generate(mat, generator, int64_t(1) << scale, config.degree, 1)) {
+                    printf("unknown generator: %s\n", generator.c_str());
+                    return 1;
+                }
+                for (const unsigned block_cols : {1u, 8u, 16u}) {
+                    const size_t mismatches = check_block_distances(mat, block_cols);
+                    printf("%s, %d rows, block width %u: %zu mismatches\n",
+                           generator.c_str(),
+                           mat.num_rows,
+                           block_cols,
+                           mismatches);
+                    failures += mismatches;
+                }
+            }
+        }
+        return failures == 0 ? 0 : 1;
+    }
+
+    FILE* csv = fopen(config.output_file.c_str(), "w");
+    if (csv == NULL) {
+        printf("cannot open %s\n", config.output_file.c_str());
+        return 1;
+    }
+    fprintf(csv, "generator,mode,threads,rows,cols,nnz,stage,repeat,ms\n");
+
+    const std::string gcsr_file = config.temp_dir + "/groot_bench.gcsr";
+    const std::string csr_file  = config.temp_dir + "/groot_bench.csr";
+
+    for (const auto& generator : config.generators) {
+        for (const int scale : config.scales) {
+            for (const int threads : config.threads) {
+                omp_set_num_threads(threads);
+                const int64_t rows = (int64_t(1) << scale) * (config.weak_scaling ? threads : 1);
+
+                for (int repeat = 0; repeat < config.repeats; repeat++) {
+                    HostCsr  mat;
+                    CPUTimer timer;
+                    auto     record = [&](const char* stage) {
+                        fprintf(csv,
+                                "%s,%s,%d,%d,%d,%d,%s,%d,%f\n",
+                                generator.c_str(),
+                                config.weak_scaling ? "weak" : "strong",
+                                threads,
+                                mat.num_rows,
+                                mat.num_cols,
+                                mat.num_entries,
+                                stage,
+                                repeat,
+                                timer.elapsed());
+                        fflush(csv);
+                    };
+
+                    timer.start();
+                    if (!generate(mat, generator, rows, config.degree, 1)) {
+                        printf("unknown generator: %s\n", generator.c_str());
+                        return 1;
+                    }
+                    timer.stop();
+                    record("generate");
+                    printf("%s: %d rows, %d nnz, %d threads, repeat %d\n",
+                           generator.c_str(),
+                           mat.num_rows,
+                           mat.num_entries,
+                           threads,
+                           repeat);
+
+                    AdjVector<int> adj;
+                    timer.start();
+                    convert_csr_to_adj(mat, adj);
+                    timer.stop();
+                    record("convert_csr_to_adj");
+
+                    // includes its own convert_csr_to_adj
+                    CsrMatrix<unsigned, float, host_memory> knn;
+                    timer.start();
+                    build_KNN_offline(mat, knn, adj, config.knn_k, config.knn_k + 50);
+                    timer.stop();
+                    record("knn");
+
+                    CooMatrix<unsigned, float, host_memory> edges;
+                    timer.start();
+                    clean_graph(knn, edges);
+                    timer.stop();
+                    record("clean_graph");
+
+                    Tree<unsigned>           tree;
+                    thrust::host_vector<int> roots, new_ids;
+                    timer.start();
+                    build_MST(edges, tree, roots);
+                    timer.stop();
+                    record("build_MST");
+
+                    timer.start();
+                    perform_DFS(tree, roots, new_ids);
+                    timer.stop();
+                    record("perform_DFS");
+
+                    HostCsr copy = mat;
+                    timer.start();
+                    build_csr_cpu(copy, new_ids);
+                    timer.stop();
+                    record("build_csr_cpu");
+
+                    copy = mat;
+                    timer.start();
+                    permute_csr_cpu(copy, new_ids);
+                    timer.stop();
+                    record("permute_csr_cpu");
+
+#ifndef GROOT_CPU_ONLY
+                    CsrMatrix<int, float, device_memory> device_mat;
+                    thrust::device_vector<int>           device_ids = new_ids;
+                    CUDATimer                            cuda_timer;
+                    device_mat.resize(mat.num_rows, mat.num_cols, mat.num_entries);
+                    device_mat.row_pointers   = mat.row_pointers;
+                    device_mat.column_indices = mat.column_indices;
+                    device_mat.values         = mat.values;
+                    cuda_timer.start();
+                    build_csr_gpu(device_mat, device_ids);
+                    cuda_timer.stop();
+                    fprintf(csv,
+                            "%s,%s,%d,%d,%d,%d,build_csr_gpu,%d,%f\n",
+                            generator.c_str(),
+                            config.weak_scaling ? "weak" : "strong",
+                            threads,
+                            mat.num_rows,
+                            mat.num_cols,
+                            mat.num_entries,
+                            repeat,
+                            cuda_timer.elapsed());
+#endif
+
+                    timer.start();
+                    write_into_csr(copy, csr_file);
+                    timer.stop();
+                    record("write_csr");
+
+                    timer.start();
+                    read_from_csr(copy, csr_file);
+                    timer.stop();
+                    record("read_csr");
+
+                    timer.start();
+                    write_into_gcsr(copy, gcsr_file, &new_ids);
+                    timer.stop();
+                    record("write_gcsr");
+
+                    timer.start();
+                    read_from_gcsr(copy, gcsr_file);
+                    timer.stop();
+                    record("read_gcsr");
+                }
+            }
+        }
+    }
+
+    std::filesystem::remove(csr_file);
+    std::filesystem::remove(gcsr_file);
+    fclose(csv);
+    printf("results written to %s\n", config.output_file.c_str());
+    return 0;
+}
@@ -1,20 +1,54 @@
+// count allocated bytes per traced phase (this is the only translation unit)
+#define GROOT_TRACE_ALLOCATIONS
 #include <groot.h>
 
 using namespace groot;
 
+#ifdef GROOT_CPU_ONLY
+using MemorySpace = host_memory;
+#else
+using MemorySpace = device_memory;
+#endif
+
 int main(int argc, char** argv)
 {
+#ifndef GROOT_CPU_ONLY
     cudaSetDevice(0);
+#endif
 
-    CsrMatrix<int, float, device_memory> A_csr;
+    CsrMatrix<int, float, MemorySpace> A_csr;
 
     Config config = program_options(argc, argv);
 
+    // many matrices in one process: host-side pipeline, see transforms/batch.h
+    if (!config.batch_file.empty()) {
+        std::vector<BatchJob> jobs;
+        if (!read_batch_manifest(config.batch_file, jobs)) {
+            return 1;
+        }
+        BatchOptions batch_options;
+        batch_options.small_workers = config.batch_workers;
+        const auto stats            = run_batch(jobs, get_reorder_options(config), batch_options);
+        print_batch_stats(stats);
+        return stats.failed == 0 ? 0 : 1;
+    }
+    Tracer::instance().enable(!config.report_file.empty() || !config.trace_file.empty());
+    if (config.perf_counters) {
+        PerfCounters::instance().enable();
+    }
+
     read_matrix_file(A_csr, config.input_file);
 
     reorder_graph(config, A_csr);
 
     write_matrix_file(A_csr, config.output_file);
 
+    if (!config.report_file.empty() && !Tracer::instance().write_json(config.report_file)) {
+        printf("cannot write report: %s\n", config.report_file.c_str());
+    }
+    if (!config.trace_file.empty() && !Tracer::instance().write_chrome_trace(config.trace_file)) {
+        printf("cannot write trace: %s\n", config.trace_file.c_str());
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,163 @@
+#pragma once
+#include <omp.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <type_traits>
+
+namespace groot {
+
+// NUMA placement of large host arrays.
+//
+// Linux places a page on the node of the thread that first writes it. A vector that is value-initialized
+// by one thread therefore ends up on a single node, and every later `omp parallel for` reads it remotely.
+// numa_allocator leaves elements default-initialized (no zero fill for arithmetic types) and, for
+// allocations of at least numa_allocation_threshold bytes, maps the memory itself and applies the policy:
+//   FirstTouch  pages are touched in parallel with schedule(static), so thread t owns the t-th slice
+//   Interleave  pages are spread round-robin over all nodes (mbind MPOL_INTERLEAVE)
+//   Bind        pages are placed on `numa_settings().node` (mbind MPOL_BIND)
+//   None        default-initialized storage, no placement
+// mbind failures (no NUMA support, seccomp) are ignored: the memory is still usable.
+
+enum class NumaPolicy { FirstTouch = 0, Interleave, Bind, None };
+
+struct NumaSettings {
+    NumaPolicy policy = NumaPolicy::FirstTouch;
+    int        node   = 0;  // for NumaPolicy::Bind
+};
+
+inline NumaSettings& numa_settings()
+{
+    static NumaSettings settings;
+    return settings;
+}
+
+// "first-touch", "interleave", "bind:<node>" or "none"
+inline bool parse_numa_policy(const std::string& text, NumaSettings& settings)
+{
+    if (text == "first-touch") {
+        settings.policy = NumaPolicy::FirstTouch;
+    }
+    else if (text == "interleave") {
+        settings.policy = NumaPolicy::Interleave;
+    }
+    else if (text.rfind("bind:", 0) == 0) {
+        // the mbind mask is a single unsigned long: nodes 0..63
+        const std::string node = text.substr(5);
+        if (node.empty() || node.size() > 2 || node.find_first_not_of("0123456789") != std::string::npos
+            || std::stoi(node) >= int(sizeof(unsigned long) * 8)) {
+            return false;
+        }
+        settings.policy = NumaPolicy::Bind;
+        settings.node   = std::stoi(node);
+    }
+    else if (text == "none") {
+        settings.policy = NumaPolicy::None;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+// bytes handed out by the global operator new and by numa_allocator's own mappings (only counted with
+// GROOT_TRACE_ALLOCATIONS, see utils/trace.h)
+inline std::atomic<uint64_t>& allocated_bytes()
+{
+    static std::atomic<uint64_t> bytes{0};
+    return bytes;
+}
+
+constexpr size_t numa_allocation_threshold = size_t(2) << 20;
+
+inline void numa_place(void* ptr, size_t bytes)
+{
+    const auto& settings = numa_settings();
+#ifdef SYS_mbind
+    constexpr int mpol_bind       = 2;
+    constexpr int mpol_interleave = 3;
+    if (settings.policy == NumaPolicy::Interleave || settings.policy == NumaPolicy::Bind) {
+        unsigned long mask = settings.policy == NumaPolicy::Bind ? 1UL << settings.node : ~0UL;
+        const int     mode = settings.policy == NumaPolicy::Bind ? mpol_bind : mpol_interleave;
+        syscall(SYS_mbind, ptr, bytes, mode, &mask, sizeof(mask) * 8, 0);
+        return;
+    }
+#endif
+    if (settings.policy == NumaPolicy::FirstTouch && !omp_in_parallel()) {
+        const size_t page  = sysconf(_SC_PAGESIZE);
+        const size_t pages = (bytes + page - 1) / page;
+        auto*        bytes_ptr = static_cast<volatile char*>(ptr);
+#pragma omp parallel for schedule(static)
+        for (size_t p = 0; p < pages; p++) {
+            bytes_ptr[p * page] = 0;
+        }
+    }
+}
+
+template<typename T>
+class numa_allocator {
+public:
+    using value_type = T;
+
+    numa_allocator() = default;
+
+    template<typename U>
+    numa_allocator(const numa_allocator<U>&) noexcept
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        const size_t bytes = n * sizeof(T);
+        if (bytes < numa_allocation_threshold) {
+            return static_cast<T*>(::operator new(bytes));
+        }
+        void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+#ifdef GROOT_TRACE_ALLOCATIONS
+        allocated_bytes().fetch_add(bytes, std::memory_order_relaxed);
+#endif
+        numa_place(ptr, bytes);
+        return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept
+    {
+        const size_t bytes = n * sizeof(T);
+        if (bytes < numa_allocation_threshold) {
+            ::operator delete(ptr);
+        }
+        else {
+            munmap(ptr, bytes);
+        }
+    }
+
+    // default-initialize instead of value-initialize: resize(n) leaves arithmetic types untouched
+    template<typename U>
+    void construct(U* ptr) noexcept(std::is_nothrow_default_constructible_v<U>)
+    {
+        ::new (static_cast<void*>(ptr)) U;
+    }
+
+    template<typename U>
+    bool operator==(const numa_allocator<U>&) const noexcept
+    {
+        return true;
+    }
+
+    template<typename U>
+    bool operator!=(const numa_allocator<U>&) const noexcept
+    {
+        return false;
+    }
+};
+
+}  // namespace groot
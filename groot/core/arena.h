@@ -0,0 +1,307 @@
+#pragma once
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace groot {
+
+// Bump arena for pipeline scratch space.
+//
+// Memory comes in large blocks aligned to 2 MB and advised for transparent huge pages (or mapped with
+// MAP_HUGETLB when enabled and pages are reserved), so scratch arrays take few page faults and TLB entries.
+// Allocation bumps a pointer; ArenaScope rewinds to where it started, so the next phase (or the next job on
+// the same thread) reuses the pages that are already faulted in. deallocate() only gives back the most
+// recent allocation (LIFO, as Thrust temporaries are freed); anything else is reclaimed by the scope.
+// Blocks are unmapped with the arena only.
+
+struct ArenaSettings {
+    size_t block_bytes = size_t(64) << 20;
+    bool   hugetlb     = false;  // try MAP_HUGETLB first (needs reserved pages, see /proc/sys/vm/nr_hugepages)
+};
+
+inline ArenaSettings& arena_settings()
+{
+    static ArenaSettings settings;
+    return settings;
+}
+
+struct ArenaStats {
+    size_t bytes_allocated = 0;  // handed out in total
+    size_t bytes_reused    = 0;  // handed out from pages an earlier allocation already used
+    size_t bytes_mapped    = 0;
+    size_t peak_bytes      = 0;  // most bytes in use at once
+    size_t blocks          = 0;
+    size_t hugetlb_blocks  = 0;
+};
+
+constexpr size_t arena_alignment = 64;
+constexpr size_t huge_page_bytes = size_t(2) << 20;
+
+class Arena {
+public:
+    struct Mark {
+        size_t block  = 0;
+        size_t offset = 0;
+    };
+
+    Arena() = default;
+
+    Arena(const Arena&)            = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena()
+    {
+        for (auto& block : blocks) {
+            munmap(block.data, block.size);
+        }
+    }
+
+    void* allocate(size_t bytes)
+    {
+        bytes = round_up(std::max<size_t>(bytes, 1), arena_alignment);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (blocks.empty() || top.offset + bytes > blocks[top.block].size) {
+            next_block(bytes);
+        }
+        Block&       block = blocks[top.block];
+        char*        ptr   = block.data + top.offset;
+        const size_t end   = top.offset + bytes;
+
+        stats_.bytes_allocated += bytes;
+        stats_.bytes_reused += std::min(end, block.used) - std::min(top.offset, block.used);
+        block.used = std::max(block.used, end);
+        top.offset = end;
+        in_use += bytes;
+        stats_.peak_bytes = std::max(stats_.peak_bytes, in_use);
+        return ptr;
+    }
+
+    void deallocate(void* ptr, size_t bytes)
+    {
+        bytes = round_up(std::max<size_t>(bytes, 1), arena_alignment);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!blocks.empty() && static_cast<char*>(ptr) + bytes == blocks[top.block].data + top.offset) {
+            top.offset -= bytes;
+            in_use -= bytes;
+        }
+    }
+
+    Mark mark()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return top;
+    }
+
+    // free everything allocated after `mark`
+    void release(Mark mark)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        top    = mark;
+        in_use = top.offset;
+        for (size_t b = 0; b < top.block; b++) {
+            in_use += blocks[b].fill;
+        }
+    }
+
+    void reset()
+    {
+        release(Mark());
+    }
+
+    ArenaStats stats()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats_;
+    }
+
+private:
+    struct Block {
+        char*  data;
+        size_t size;
+        size_t used;  // high-water mark: pages below it are faulted in
+        size_t fill;  // bytes in use when the arena moved on to the next block
+        bool   hugetlb;
+    };
+
+    static size_t round_up(size_t bytes, size_t alignment)
+    {
+        return (bytes + alignment - 1) / alignment * alignment;
+    }
+
+    // continue in the next block, replacing it if it is too small (everything after `top` is free)
+    void next_block(size_t bytes)
+    {
+        const size_t next = blocks.empty() ? 0 : top.block + 1;
+        if (!blocks.empty()) {
+            blocks[top.block].fill = top.offset;
+        }
+        if (next == blocks.size()) {
+            blocks.push_back(map_block(bytes));
+        }
+        else if (blocks[next].size < bytes) {
+            unmap_block(blocks[next]);
+            blocks[next] = map_block(bytes);
+        }
+        top = Mark{next, 0};
+    }
+
+    Block map_block(size_t bytes)
+    {
+        const auto& settings = arena_settings();
+        const size_t size    = round_up(std::max(bytes, settings.block_bytes), huge_page_bytes);
+
+        void* data = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if (settings.hugetlb) {
+            data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+#endif
+        const bool hugetlb = data != MAP_FAILED;
+        if (data == MAP_FAILED) {
+            // over-allocate by one huge page and trim, so the block starts on a huge-page boundary
+            char* raw = static_cast<char*>(
+                mmap(nullptr, size + huge_page_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+            if (raw == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            const size_t misalign = reinterpret_cast<uintptr_t>(raw) % huge_page_bytes;
+            const size_t head     = misalign == 0 ? 0 : huge_page_bytes - misalign;
+            char*        aligned  = raw + head;
+            if (head > 0) {
+                munmap(raw, head);
+            }
+            munmap(aligned + size, huge_page_bytes - head);
+            data = aligned;
+#ifdef MADV_HUGEPAGE
+            madvise(data, size, MADV_HUGEPAGE);
+#endif
+            numa_place(data, size);
+        }
+        stats_.bytes_mapped += size;
+        stats_.blocks++;
+        stats_.hugetlb_blocks += hugetlb;
+        return Block{static_cast<char*>(data), size, 0, 0, hugetlb};
+    }
+
+    void unmap_block(Block& block)
+    {
+        munmap(block.data, block.size);
+        stats_.bytes_mapped -= block.size;
+        stats_.blocks--;
+        stats_.hugetlb_blocks -= block.hugetlb;
+    }
+
+    std::vector<Block> blocks;
+    Mark               top;
+    size_t             in_use = 0;
+    ArenaStats         stats_;
+    std::mutex         mutex;
+};
+
+// Rewinds the arena to where it was on construction
+class ArenaScope {
+public:
+    explicit ArenaScope(Arena& arena): arena(arena), mark(arena.mark()) {}
+
+    ArenaScope(const ArenaScope&)            = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+    ~ArenaScope()
+    {
+        arena.release(mark);
+    }
+
+private:
+    Arena&      arena;
+    Arena::Mark mark;
+};
+
+// Scratch arena of the calling thread: reused by every phase, and by every job a batch worker runs
+inline Arena& scratch_arena()
+{
+    thread_local Arena arena;
+    return arena;
+}
+
+// Allocator over an Arena; elements are default-initialized like numa_allocator
+template<typename T>
+class arena_allocator {
+public:
+    using value_type = T;
+
+    arena_allocator(Arena& arena) noexcept: arena(&arena) {}
+
+    template<typename U>
+    arena_allocator(const arena_allocator<U>& other) noexcept: arena(other.arena)
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(arena->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept
+    {
+        arena->deallocate(ptr, n * sizeof(T));
+    }
+
+    template<typename U>
+    void construct(U* ptr) noexcept(std::is_nothrow_default_constructible_v<U>)
+    {
+        ::new (static_cast<void*>(ptr)) U;
+    }
+
+    template<typename U>
+    bool operator==(const arena_allocator<U>& other) const noexcept
+    {
+        return arena == other.arena;
+    }
+
+    template<typename U>
+    bool operator!=(const arena_allocator<U>& other) const noexcept
+    {
+        return arena != other.arena;
+    }
+
+    Arena* arena;
+};
+
+// Scratch vector: must not outlive the ArenaScope it was allocated in
+template<typename T>
+using ArenaVector = thrust::host_vector<T, arena_allocator<T>>;
+
+// Like get_exec_policy(), but host algorithms take their temporary buffers from `alloc`
+template<typename Vector>
+auto get_exec_policy(arena_allocator<char>& alloc)
+{
+    if constexpr (is_device_vector<Vector>::value) {
+        return thrust::device;
+    }
+    else {
+        return thrust::omp::par(alloc);
+    }
+}
+
+inline void print_arena_stats(const ArenaStats& stats)
+{
+    const double mb = 1 << 20;
+    printf("[arena] scratch (MB): %.2f allocated, %.2f reused, %.2f peak, %.2f mapped in %zu blocks (%zu hugetlb)\n",
+           stats.bytes_allocated / mb,
+           stats.bytes_reused / mb,
+           stats.peak_bytes / mb,
+           stats.bytes_mapped / mb,
+           stats.blocks,
+           stats.hugetlb_blocks);
+}
+
+}  // namespace groot
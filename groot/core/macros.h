@@ -3,6 +3,13 @@
 #include <cstdlib>
 #include <iostream>
 
+// Host-only builds (GROOT_CPU_ONLY): the CUDA qualifiers compile away and the
+// Thrust "device" system is the OpenMP backend.
+#if !defined(__CUDACC__) && !defined(__host__)
+#define __host__
+#define __device__
+#endif
+
 namespace groot {
 
 #define ASSERT(condition)                                                                                              \
@@ -6,6 +6,11 @@
 
 namespace groot {
 
+// Host vectors use numa_allocator: large arrays are placed by parallel first touch and resize() does not
+// zero them, so every phase must write what it reads
+template<typename T>
+using HostVector = thrust::host_vector<T, numa_allocator<T>>;
+
 // Memory space tags
 struct host_memory {};
 struct device_memory {};
@@ -15,7 +20,7 @@ struct VectorTrait;
 
 template<typename T>
 struct VectorTrait<T, host_memory> {
-    using MemoryVector = thrust::host_vector<T>;
+    using MemoryVector = HostVector<T>;
     static constexpr auto execution_policy() -> decltype(thrust::host)
     {
         return thrust::host;
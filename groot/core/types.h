@@ -1,13 +1,17 @@
 #pragma once
 
+#ifndef GROOT_CPU_ONLY
 #include <cuda_fp16.h>
+#endif
 #include <cstdint>
 
 namespace groot {
 
 using uint8_t = unsigned char;
 using groot64_t = unsigned long long int;
-using half    = __half;
-using half2   = __half2;
+#ifndef GROOT_CPU_ONLY
+using half  = __half;
+using half2 = __half2;
+#endif
 
 }  // namespace groot
\ No newline at end of file
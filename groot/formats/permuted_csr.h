@@ -0,0 +1,156 @@
+#pragma once
+#include <omp.h>
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+namespace groot {
+
+// Read-only view of a host CSR renumbered by new_ids[old_row] = new_row, without rebuilding it.
+//
+// Rows (and, for square matrices, columns unless disabled) are permuted lazily: for_each_entry() walks one
+// permuted row in place, copy_row() returns it sorted, and for_each_block() materializes consecutive
+// permuted rows in small blocks for streaming consumers (e.g. write_blocks_into_csr). The view keeps a copy
+// of new_ids (to relabel columns) and its inverse (to find the source of each row), two arrays of num_rows.
+// Block rows come out sorted and deduplicated, as after permute_csr_cpu.
+template<typename CsrMatrix>
+class PermutedCsrView {
+public:
+    using index_type   = typename CsrMatrix::index_type;
+    using value_type   = typename CsrMatrix::value_type;
+    using memory_space = host_memory;
+    using BlockMatrix  = CsrMatrix;
+
+    static_assert(std::is_same_v<typename CsrMatrix::memory_space, host_memory>, "PermutedCsrView needs a host matrix");
+
+    index_type num_rows;
+    index_type num_cols;
+    index_type num_entries;  // before deduplication
+
+    template<typename Vector>
+    PermutedCsrView(const CsrMatrix& mat, const Vector& new_ids, bool permute_columns = true):
+        num_rows(mat.num_rows),
+        num_cols(mat.num_cols),
+        num_entries(mat.num_entries),
+        mat(mat),
+        new_ids(new_ids.begin(), new_ids.end()),
+        old_ids(mat.num_rows),
+        permute_columns(permute_columns && mat.num_rows == mat.num_cols)
+    {
+        ASSERT(this->new_ids.size() == size_t(mat.num_rows));
+#pragma omp parallel for
+        for (index_type i = 0; i < num_rows; i++) {
+            old_ids[this->new_ids[i]] = i;
+        }
+    }
+
+    index_type row_length(index_type row) const
+    {
+        const auto old = old_ids[row];
+        return mat.row_pointers[old + 1] - mat.row_pointers[old];
+    }
+
+    index_type new_column(index_type col) const
+    {
+        return permute_columns ? new_ids[col] : col;
+    }
+
+    // f(new_col, value) for every entry of permuted row `row`, in the original column order
+    template<typename F>
+    void for_each_entry(index_type row, F f) const
+    {
+        const auto old = old_ids[row];
+        for (auto j = mat.row_pointers[old]; j < mat.row_pointers[old + 1]; j++) {
+            f(new_column(mat.column_indices[j]), mat.values[j]);
+        }
+    }
+
+    // Permuted row `row` sorted by column into `cols`/`vals` (row_length() slots); returns its length
+    index_type copy_row(index_type row, index_type* cols, value_type* vals) const
+    {
+        index_type len = 0;
+        for_each_entry(row, [&](index_type col, value_type val) {
+            cols[len]   = col;
+            vals[len++] = val;
+        });
+        std::vector<index_type> col_buffer;
+        std::vector<value_type> val_buffer;
+        return sort_segment(cols, vals, len, true, col_buffer, val_buffer);
+    }
+
+    // Materialize permuted rows [first, first + block_rows) into `block` (block.num_rows rows, local row pointers)
+    void get_block(index_type first, index_type block_rows, BlockMatrix& block) const
+    {
+        const index_type count = std::min<index_type>(block_rows, num_rows - first);
+
+        block.num_rows = count;
+        block.num_cols = num_cols;
+        block.row_pointers.resize(count + 1);
+        block.row_pointers[0] = 0;
+        for (index_type r = 0; r < count; r++) {
+            block.row_pointers[r + 1] = block.row_pointers[r] + row_length(first + r);
+        }
+        block.column_indices.resize(block.row_pointers[count]);
+        block.values.resize(block.row_pointers[count]);
+
+        // sort every row; lengths shrink only when the input had duplicates
+        thrust::host_vector<index_type> lengths(count);
+#pragma omp parallel
+        {
+            std::vector<index_type> col_buffer;
+            std::vector<value_type> val_buffer;
+#pragma omp for schedule(dynamic, 64)
+            for (index_type r = 0; r < count; r++) {
+                index_type* cols = block.column_indices.data() + block.row_pointers[r];
+                value_type* vals = block.values.data() + block.row_pointers[r];
+                index_type  len  = 0;
+                for_each_entry(first + r, [&](index_type col, value_type val) {
+                    cols[len]   = col;
+                    vals[len++] = val;
+                });
+                lengths[r] = sort_segment(cols, vals, len, true, col_buffer, val_buffer);
+            }
+        }
+
+        index_type out = 0;
+        for (index_type r = 0; r < count; r++) {
+            const index_type begin = block.row_pointers[r];
+            if (out != begin) {
+                std::copy_n(block.column_indices.begin() + begin, lengths[r], block.column_indices.begin() + out);
+                std::copy_n(block.values.begin() + begin, lengths[r], block.values.begin() + out);
+            }
+            block.row_pointers[r] = out;
+            out += lengths[r];
+        }
+        block.row_pointers[count] = out;
+        block.num_entries         = out;
+        block.column_indices.resize(out);
+        block.values.resize(out);
+    }
+
+    // f(first_row, block) for consecutive blocks of `block_rows` permuted rows; one block buffer is reused
+    template<typename F>
+    void for_each_block(index_type block_rows, F f) const
+    {
+        BlockMatrix block;
+        for (index_type first = 0; first < num_rows; first += block_rows) {
+            get_block(first, block_rows, block);
+            f(first, static_cast<const BlockMatrix&>(block));
+        }
+    }
+
+    // The whole permuted matrix (same result as permute_csr_cpu on a copy)
+    void materialize(CsrMatrix& out) const
+    {
+        get_block(0, num_rows, out);
+    }
+
+private:
+    const CsrMatrix&                mat;
+    thrust::host_vector<index_type> new_ids;
+    thrust::host_vector<index_type> old_ids;
+    bool                            permute_columns;
+};
+
+}  // namespace groot
@@ -4,7 +4,9 @@
 // Core includes
 #include "core/types.h"
 #include "core/macros.h"
+#include "core/allocator.h"
 #include "core/memory.h"
+#include "core/arena.h"
 
 
 // Matrix formats
@@ -15,17 +17,34 @@
 // Utilities - Helpers
 #include "utils/functors.h"
 #include "utils/timer.h"
+#include "utils/perf.h"
+#include "utils/trace.h"
 #include "utils/csr_helpers.h"
-#include "utils/option.h"
+#include "utils/hash.h"
+#include "utils/generators.h"
 
 
 // Utilities - IO
+#include "utils/io/mmap.h"
 #include "utils/io/mmio.h"
+#include "utils/io/gcsr.h"
+#include "utils/io/garray.h"
+#include "utils/io/parse.h"
 #include "utils/io/read.h"
 #include "utils/io/write.h"
+#include "utils/cache.h"
+
+
+// Matrix views (built on the CSR helpers)
+#include "formats/permuted_csr.h"
 
 
 // Transform Matrix
 #include "transforms/knn.h"
+#include "utils/option.h"  // Config holds a KnnMetric
+#include "transforms/reorderer.h"
+#include "transforms/incremental.h"
+#include "transforms/columns.h"
 #include "transforms/reorder.h"
+#include "transforms/batch.h"
 
@@ -0,0 +1,281 @@
+#pragma once
+#include <omp.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace groot {
+
+// Batch reordering of many matrices in one process.
+//
+//   reader --(queue)--> reorder workers --(queue)--> writer
+//
+// The reader prefetches up to `queue_depth` matrices while the workers reorder and the writer stores
+// earlier results. Jobs below `large_nnz` run concurrently on `small_workers` workers with an equal share of
+// the OpenMP threads each; a large job takes all threads and runs alone. Every worker keeps its own
+// Reorderer and scratch arena, so KNN/MST workspaces and phase temporaries are reused from job to job.
+// Everything stays in host memory.
+
+struct BatchJob {
+    std::string input_file;
+    std::string output_file;       // may be empty
+    std::string permutation_file;  // may be empty
+};
+
+struct BatchOptions {
+    int    small_workers = 0;        // concurrent small jobs (0: a quarter of the threads)
+    size_t large_nnz     = 1 << 22;  // jobs with at least this many nonzeros run alone with all threads
+    size_t queue_depth   = 4;        // matrices buffered between the stages
+};
+
+struct BatchStats {
+    size_t jobs       = 0;
+    size_t failed     = 0;
+    size_t large_jobs = 0;
+    size_t nnz        = 0;
+
+    size_t scratch_allocated = 0;  // summed over the workers' scratch arenas
+    size_t scratch_reused    = 0;
+
+    double read_ms    = 0;  // summed over jobs
+    double reorder_ms = 0;
+    double rebuild_ms = 0;
+    double write_ms   = 0;
+    double wall_ms    = 0;
+};
+
+// One job per line: `input [output] [permutation_file]`; blank lines and `#` comments are skipped
+inline bool read_batch_manifest(const std::string& filename, std::vector<BatchJob>& jobs)
+{
+    std::ifstream manifest(filename);
+    if (!manifest.is_open()) {
+        std::cout << "cannot open the manifest!" << std::endl;
+        return false;
+    }
+    for (std::string line; std::getline(manifest, line);) {
+        std::istringstream fields(line);
+        BatchJob           job;
+        if (!(fields >> job.input_file) || job.input_file[0] == '#') {
+            continue;
+        }
+        fields >> job.output_file >> job.permutation_file;
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+// Bounded blocking queue; pop() returns nothing once the queue is closed and drained
+template<typename T>
+class BatchQueue {
+public:
+    explicit BatchQueue(size_t capacity): capacity(std::max<size_t>(capacity, 1)) {}
+
+    void push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [&] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+    }
+
+    std::optional<T> pop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [&] { return !items.empty() || closed; });
+        if (items.empty()) {
+            return std::nullopt;
+        }
+        T item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return item;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+    }
+
+private:
+    size_t                  capacity;
+    bool                    closed{false};
+    std::deque<T>           items;
+    std::mutex              mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+};
+
+template<typename CsrMatrix>
+struct BatchItem {
+    BatchJob                   job;
+    std::unique_ptr<CsrMatrix> mat;
+    thrust::host_vector<int>   new_ids;
+    bool                       ok{true};
+};
+
+template<typename IndexType = int, typename ValueType = float>
+BatchStats run_batch(const std::vector<BatchJob>& jobs,
+                     const ReorderOptions&        reorder_options,
+                     const BatchOptions&          batch_options = BatchOptions())
+{
+    using Matrix = CsrMatrix<IndexType, ValueType, host_memory>;
+    using Item   = BatchItem<Matrix>;
+
+    const int total_threads = omp_get_max_threads();
+    const int small_workers =
+        batch_options.small_workers > 0 ? batch_options.small_workers : std::max(1, total_threads / 4);
+    const int small_threads = std::max(1, total_threads / small_workers);
+
+    BatchStats        stats;
+    std::mutex        stats_mutex;
+    std::shared_mutex large_lock;  // small jobs share it, a large job holds it alone
+    BatchQueue<Item>  loaded(batch_options.queue_depth);
+    BatchQueue<Item>  reordered(batch_options.queue_depth);
+    CPUTimer          wall;
+    wall.start();
+
+    auto add_time = [&](double BatchStats::*field, double ms) {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        stats.*field += ms;
+    };
+
+    std::thread reader([&] {
+        omp_set_num_threads(small_threads);
+        for (const auto& job : jobs) {
+            Item     item;
+            CPUTimer timer;
+            item.job = job;
+            item.mat = std::make_unique<Matrix>();
+            timer.start();
+            item.ok = try_read_matrix_file(*item.mat, job.input_file);
+            timer.stop();
+            add_time(&BatchStats::read_ms, timer.elapsed());
+            loaded.push(std::move(item));
+        }
+        loaded.close();
+    });
+
+    std::vector<std::thread> workers;
+    std::atomic<int>         active_workers{small_workers};
+    std::atomic<bool>        warned_blocks{false};  // see reorder_graph: once per batch
+    for (int w = 0; w < small_workers; w++) {
+        workers.emplace_back([&] {
+            Reorderer reorderer(reorder_options);
+            while (auto next = loaded.pop()) {
+                Item& item = *next;
+                if (item.ok) {
+                    const bool large = size_t(item.mat->num_entries) >= batch_options.large_nnz;
+                    CPUTimer   timer;
+
+                    std::unique_lock<std::shared_mutex> exclusive(large_lock, std::defer_lock);
+                    std::shared_lock<std::shared_mutex> shared(large_lock, std::defer_lock);
+                    if (large) {
+                        exclusive.lock();
+                    }
+                    else {
+                        shared.lock();
+                    }
+                    omp_set_num_threads(large ? total_threads : small_threads);
+
+                    const auto scratch = scratch_arena().stats();
+                    item.new_ids.resize(item.mat->num_rows);
+                    add_time(&BatchStats::reorder_ms, reorderer.compute(*item.mat, item.new_ids).total_ms);
+                    if (!item.job.output_file.empty()) {
+                        if (reorder_options.knn_metric == KnnMetric::Blocks
+                            && item.mat->num_rows == item.mat->num_cols && !warned_blocks.exchange(true)) {
+                            printf("[batch] warning: square matrices are rebuilt symmetrically, which relabels the "
+                                   "columns the blocks metric grouped rows by\n");
+                        }
+                        timer.start();
+                        permute_csr_cpu(*item.mat, item.new_ids);
+                        timer.stop();
+                        add_time(&BatchStats::rebuild_ms, timer.elapsed());
+                    }
+
+                    std::lock_guard<std::mutex> lock(stats_mutex);
+                    stats.scratch_allocated += scratch_arena().stats().bytes_allocated - scratch.bytes_allocated;
+                    stats.scratch_reused += scratch_arena().stats().bytes_reused - scratch.bytes_reused;
+                    stats.large_jobs += large;
+                }
+                reordered.push(std::move(item));
+            }
+            if (--active_workers == 0) {
+                reordered.close();
+            }
+        });
+    }
+
+    std::thread writer([&] {
+        omp_set_num_threads(small_threads);
+        while (auto next = reordered.pop()) {
+            Item&    item = *next;
+            CPUTimer timer;
+            timer.start();
+            if (item.ok) {
+                item.ok = try_write_matrix_file(*item.mat, item.job.output_file, &item.new_ids);
+            }
+            if (item.ok && !item.job.permutation_file.empty()) {
+                item.ok = write_permutation_file(item.new_ids, item.job.permutation_file);
+            }
+            timer.stop();
+
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            stats.write_ms += timer.elapsed();
+            stats.jobs++;
+            if (item.ok) {
+                stats.nnz += item.mat->num_entries;
+            }
+            else {
+                stats.failed++;
+                printf("[batch] job failed: %s\n", item.job.input_file.c_str());
+            }
+        }
+    });
+
+    reader.join();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    writer.join();
+    omp_set_num_threads(total_threads);
+
+    wall.stop();
+    stats.wall_ms = wall.elapsed();
+    return stats;
+}
+
+inline void print_batch_stats(const BatchStats& stats)
+{
+    const double seconds = stats.wall_ms / 1e3;
+    printf("[batch] jobs: %zu (failed: %zu, large: %zu), nnz: %zu\n",
+           stats.jobs,
+           stats.failed,
+           stats.large_jobs,
+           stats.nnz);
+    printf("[batch] summed stage time (ms): read %f, reorder %f, rebuild %f, write %f\n",
+           stats.read_ms,
+           stats.reorder_ms,
+           stats.rebuild_ms,
+           stats.write_ms);
+    printf("[batch] scratch (MB): %.2f allocated, %.2f reused\n",
+           stats.scratch_allocated / double(1 << 20),
+           stats.scratch_reused / double(1 << 20));
+    printf("[batch] wall time (ms): %f, throughput: %.2f jobs/s, %.2f Mnnz/s\n",
+           stats.wall_ms,
+           seconds > 0 ? stats.jobs / seconds : 0.0,
+           seconds > 0 ? stats.nnz / seconds / 1e6 : 0.0);
+}
+
+}  // namespace groot
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+namespace groot {
+
+// Tile of A in a tensor-core SpMM: `rows` rows of A (one row panel) by `cols` of its columns (one k step)
+struct TileShape {
+    int rows = 16;
+    int cols = 8;
+};
+
+struct TileStats {
+    size_t tiles = 0;  // tiles holding at least one nonzero
+    size_t nnz   = 0;
+
+    // nonzeros per tile slot: the share of the tensor-core work that is useful
+    double density(TileShape shape) const
+    {
+        return tiles ? double(nnz) / (double(tiles) * shape.rows * shape.cols) : 0.0;
+    }
+};
+
+// Nonzero tiles of a host CSR once row i is moved to row_id[i] and column j to col_id[j] (col_id == nullptr:
+// columns stay). Nothing is materialized: each thread walks whole row panels and stamps the tile columns seen.
+template<typename CSR, typename Vector>
+TileStats count_tiles(const CSR& mat, const Vector& row_id, const Vector* col_id, TileShape shape)
+{
+    using IndexType = typename CSR::index_type;
+    ASSERT(size_t(mat.num_rows) == row_id.size() && (!col_id || size_t(mat.num_cols) == col_id->size()));
+
+    const IndexType nrow       = mat.num_rows;
+    const int64_t   num_panels = (int64_t(nrow) + shape.rows - 1) / shape.rows;
+    const size_t    tile_cols  = (size_t(mat.num_cols) + shape.cols - 1) / shape.cols;
+    const auto*     rowptr     = mat.row_pointers.data();
+    const auto*     colidx     = mat.column_indices.data();
+
+    HostVector<IndexType> old_row(nrow);
+#pragma omp parallel for
+    for (IndexType i = 0; i < nrow; i++) {
+        old_row[row_id[i]] = i;
+    }
+
+    TileStats stats;
+    stats.nnz   = mat.num_entries;
+    size_t tiles = 0;
+#pragma omp parallel reduction(+ : tiles)
+    {
+        std::vector<int64_t> stamp(tile_cols, -1);  // last panel that touched each tile column
+#pragma omp for schedule(dynamic, 64)
+        for (int64_t p = 0; p < num_panels; p++) {
+            const IndexType last = std::min<int64_t>(nrow, (p + 1) * shape.rows);
+            for (IndexType r = p * shape.rows; r < last; r++) {
+                const IndexType i = old_row[r];
+                for (IndexType j = rowptr[i]; j < rowptr[i + 1]; j++) {
+                    const size_t t = size_t(col_id ? (*col_id)[colidx[j]] : colidx[j]) / shape.cols;
+                    if (stamp[t] != p) {
+                        stamp[t] = p;
+                        tiles++;
+                    }
+                }
+            }
+        }
+    }
+    stats.tiles = tiles;
+    return stats;
+}
+
+// Tile counts of the ways a row permutation (and a column permutation, when given) can be applied:
+// the original order, rows only (P A), symmetric (P A P^T, square only) and two-sided (P A Q)
+template<typename CSR, typename Vector>
+void print_tile_report(const CSR& mat, const Vector& row_ids, const Vector* col_ids, TileShape shape)
+{
+    if constexpr (!std::is_same_v<typename CSR::memory_space, host_memory>) {
+        CsrMatrix<typename CSR::index_type, typename CSR::value_type, host_memory> host;
+        host.num_rows       = mat.num_rows;
+        host.num_cols       = mat.num_cols;
+        host.num_entries    = mat.num_entries;
+        host.row_pointers   = mat.row_pointers;
+        host.column_indices = mat.column_indices;
+        print_tile_report(host, row_ids, col_ids, shape);
+    }
+    else {
+        auto print = [&](const char* mode, const TileStats& stats) {
+            printf("[Tiles] %-10s %dx%d tiles: %zu, density: %.4f\n",
+                   mode,
+                   shape.rows,
+                   shape.cols,
+                   stats.tiles,
+                   stats.density(shape));
+        };
+        Vector identity(mat.num_rows);
+        std::iota(identity.begin(), identity.end(), 0);
+        print("original", count_tiles(mat, identity, static_cast<const Vector*>(nullptr), shape));
+        print("row-only", count_tiles(mat, row_ids, static_cast<const Vector*>(nullptr), shape));
+        if (mat.num_rows == mat.num_cols) {
+            print("symmetric", count_tiles(mat, row_ids, &row_ids, shape));
+        }
+        if (col_ids) {
+            print("two-sided", count_tiles(mat, row_ids, col_ids, shape));
+        }
+    }
+}
+
+// Column j of A as a row of the panel matrix: the row panels (of `panel_rows` rows, after moving row i to
+// row_ids[i]) in which column j has a nonzero. With panel_rows = 1 this is the transpose of P A.
+// The panels are split into nnz-balanced ranges, one per part; each part stamps the columns it has seen in
+// its current panel and counts them per column, a prefix over (column, part) gives every part its own write
+// cursor in each row, and a second walk fills them. Parts cover increasing panels, so the rows come out
+// sorted and deduplicated. As in transpose_with_map, the number of parts keeps the per-part arrays in the
+// order of nnz; they live in the scratch arena.
+template<typename CSR, typename Vector>
+CsrMatrix<int, float, host_memory> get_panel_matrix(const CSR& mat, const Vector& row_ids, int panel_rows)
+{
+    using IndexType = typename CSR::index_type;
+
+    const IndexType nrow       = mat.num_rows;
+    const IndexType ncol       = mat.num_cols;
+    const IndexType num_panels = (nrow + panel_rows - 1) / panel_rows;
+    const auto*     rowptr     = mat.row_pointers.data();
+    const auto*     colidx     = mat.column_indices.data();
+
+    HostVector<IndexType> old_row(nrow);
+#pragma omp parallel for
+    for (IndexType i = 0; i < nrow; i++) {
+        old_row[row_ids[i]] = i;
+    }
+
+    // nonzeros per panel, for the balanced split
+    HostVector<IndexType> panel_ptr(num_panels + 1);
+#pragma omp parallel for schedule(static)
+    for (IndexType p = 0; p < num_panels; p++) {
+        const IndexType end = std::min<int64_t>(nrow, int64_t(p + 1) * panel_rows);
+        IndexType       nnz = 0;
+        for (IndexType r = p * panel_rows; r < end; r++) {
+            nnz += rowptr[old_row[r] + 1] - rowptr[old_row[r]];
+        }
+        panel_ptr[p] = nnz;
+    }
+    panel_ptr[num_panels] = 0;
+    thrust::exclusive_scan(thrust::host, panel_ptr.begin(), panel_ptr.end(), panel_ptr.begin());
+
+    const int64_t entries_per_col = std::max<int64_t>(1, int64_t(mat.num_entries) / std::max<int64_t>(ncol, 1));
+    const int     num_parts       = std::clamp<int64_t>(4 * entries_per_col, 1, omp_get_max_threads());
+    const auto    bounds          = partition_rows_by_nnz(panel_ptr.data(), num_panels, num_parts);
+
+    CsrMatrix<int, float, host_memory> panels;
+    auto&                              row_start = panels.row_pointers;
+    panels.num_rows                              = ncol;
+    panels.num_cols                              = num_panels;
+    row_start.resize(ncol + 1);
+
+    ArenaScope             scratch(scratch_arena());
+    ArenaVector<IndexType> counts(size_t(num_parts) * ncol, scratch_arena());
+    ArenaVector<IndexType> stamps(size_t(num_parts) * ncol, scratch_arena());
+
+    // visit(column, panel) once per distinct pair in the panels of `part`, in increasing panel order
+    auto for_each_entry = [&](int part, auto&& visit) {
+        IndexType* last = stamps.data() + size_t(part) * ncol;
+        std::fill_n(last, ncol, IndexType(-1));
+        for (IndexType p = bounds[part]; p < bounds[part + 1]; p++) {
+            const IndexType end = std::min<int64_t>(nrow, int64_t(p + 1) * panel_rows);
+            for (IndexType r = p * panel_rows; r < end; r++) {
+                const IndexType i = old_row[r];
+                for (IndexType j = rowptr[i]; j < rowptr[i + 1]; j++) {
+                    if (last[colidx[j]] != p) {
+                        last[colidx[j]] = p;
+                        visit(colidx[j], p);
+                    }
+                }
+            }
+        }
+    };
+
+#pragma omp parallel for schedule(static, 1)
+    for (int part = 0; part < num_parts; part++) {
+        IndexType* count = counts.data() + size_t(part) * ncol;
+        std::fill_n(count, ncol, IndexType(0));
+        for_each_entry(part, [&](IndexType c, IndexType) { count[c]++; });
+    }
+
+#pragma omp parallel for schedule(static)
+    for (IndexType c = 0; c < ncol; c++) {
+        IndexType running = 0;
+        for (int part = 0; part < num_parts; part++) {
+            const IndexType tmp             = counts[size_t(part) * ncol + c];
+            counts[size_t(part) * ncol + c] = running;
+            running += tmp;
+        }
+        row_start[c] = running;
+    }
+    row_start[ncol] = 0;
+    thrust::exclusive_scan(thrust::host, row_start.begin(), row_start.end(), row_start.begin());
+
+    panels.num_entries = row_start[ncol];
+    panels.column_indices.resize(panels.num_entries);
+    panels.values.resize(panels.num_entries);
+    thrust::fill(panels.values.begin(), panels.values.end(), 1.0f);
+
+    auto* panel_col = panels.column_indices.data();
+#pragma omp parallel for schedule(static, 1)
+    for (int part = 0; part < num_parts; part++) {
+        IndexType* cursor = counts.data() + size_t(part) * ncol;
+        for_each_entry(part, [&](IndexType c, IndexType p) { panel_col[row_start[c] + cursor[c]++] = p; });
+    }
+    return panels;
+}
+
+// Order the columns of A independently of its rows: Groot runs on the panel matrix, so columns that share
+// row panels (tiles) of P A become neighbors. col_ids[old_col] = new_col.
+template<typename CSR, typename Vector>
+ReorderStats order_columns(const ReorderOptions& options,
+                           const CSR&            mat,
+                           const Vector&         row_ids,
+                           TileShape             shape,
+                           Vector&               col_ids)
+{
+    if constexpr (!std::is_same_v<typename CSR::memory_space, host_memory>) {
+        CsrMatrix<typename CSR::index_type, typename CSR::value_type, host_memory> host;
+        host.num_rows       = mat.num_rows;
+        host.num_cols       = mat.num_cols;
+        host.num_entries    = mat.num_entries;
+        host.row_pointers   = mat.row_pointers;
+        host.column_indices = mat.column_indices;
+        return order_columns(options, host, row_ids, shape, col_ids);
+    }
+    else {
+        TraceScope scope("columns");
+        const auto panels = get_panel_matrix(mat, row_ids, shape.rows);
+
+        Reorderer reorderer(options);
+        col_ids.resize(mat.num_cols);
+        return reorderer.compute(panels, col_ids);
+    }
+}
+
+// Relabel the columns of a host CSR (column j becomes col_id[j]) and sort each row again
+template<typename CsrMatrix, typename Vector>
+void permute_columns_cpu(CsrMatrix& mat, const Vector& col_id)
+{
+    using IndexType = typename CsrMatrix::index_type;
+    ASSERT(size_t(mat.num_cols) == col_id.size());
+
+    const IndexType nnz    = mat.num_entries;
+    auto*           colidx = mat.column_indices.data();
+#pragma omp parallel for
+    for (IndexType j = 0; j < nnz; j++) {
+        colidx[j] = col_id[colidx[j]];
+    }
+    segmented_sort_rows(mat.row_pointers, mat.column_indices, &mat.values, false);
+}
+
+}  // namespace groot
@@ -0,0 +1,822 @@
+#pragma once
+#include <omp.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace groot {
+
+// Incremental KNN -> MST -> DFS reordering for matrices that change a little at a time.
+//
+// initialize() runs the full pipeline and keeps its KNN lists, the spanning forest (with edge weights) and
+// the row order. update() takes the updated matrix (rows keep their ids, new rows are appended) and a delta,
+// and only touches what the delta reaches:
+//   1. KNN    affected rows get new lists by a local NN-descent seeded with their old list and their column
+//             ids; every row evaluated on the way adopts the affected row if it is now closer
+//   2. MST    tree edges of changed rows are re-weighted, the tree neighbors of a removed row are reconnected
+//             by a small MST among themselves, new rows attach to their nearest neighbor, and every new KNN
+//             edge replaces the heaviest edge on its tree cycle if it is lighter (cycle search is capped)
+//   3. DFS    added and changed rows are spliced into the order right after their lightest tree neighbor;
+//             removed rows become tombstones at the end
+// The KNN, forest and neighbor search work follows the delta; splicing still rewrites the order (linear in
+// the number of rows). The result approximates a full rerun, so call initialize() again once the accumulated
+// delta is large. save()/load() keep the state between runs (linear in rows x K), and diff() derives the
+// delta by hashing every row (parallel, linear in the nonzeros). Callers that know their delta pass it to
+// update() directly and skip diff().
+
+constexpr unsigned invalid_row = std::numeric_limits<unsigned>::max();
+
+struct MatrixDelta {
+    std::vector<unsigned> added;    // rows without state: tombstones coming back (appended rows are implied)
+    std::vector<unsigned> changed;  // rows whose pattern changed
+    std::vector<unsigned> removed;  // rows to drop; their row in the updated matrix is ignored
+};
+
+struct IncrementalOptions {
+    unsigned descent_rounds  = 2;     // local NN-descent rounds per affected row
+    size_t   max_path_search = 1024;  // forest nodes visited when looking for the cycle of a new KNN edge
+    unsigned max_reconnect   = 32;    // tree neighbors of a removed row reconnected by an exact local MST
+};
+
+struct IncrementalStats {
+    size_t added   = 0;
+    size_t changed = 0;
+    size_t removed = 0;
+
+    size_t distance_evaluations = 0;
+    size_t lists_updated        = 0;  // KNN lists of other rows that adopted or dropped an affected row
+    size_t edges_replaced       = 0;  // tree edges swapped for a lighter KNN edge
+    size_t rows_spliced         = 0;  // rows placed next to a tree neighbor
+    size_t tombstones           = 0;
+
+    double knn_ms   = 0;
+    double mst_ms   = 0;
+    double dfs_ms   = 0;
+    double total_ms = 0;
+};
+
+// Distance between two rows of a host CSR with sorted rows (as the KNN graph measures it, see row_distance)
+template<typename CSR>
+float csr_row_distance(
+    const CSR& mat, size_t a, size_t b, KnnMetric metric = KnnMetric::Hamming, unsigned block_cols = 8)
+{
+    const auto a_begin = mat.row_pointers[a];
+    const auto b_begin = mat.row_pointers[b];
+    return row_distance(metric,
+                        mat.column_indices.data() + a_begin,
+                        mat.values.data() + a_begin,
+                        size_t(mat.row_pointers[a + 1] - a_begin),
+                        mat.column_indices.data() + b_begin,
+                        mat.values.data() + b_begin,
+                        size_t(mat.row_pointers[b + 1] - b_begin),
+                        block_cols);
+}
+
+// Hash of the column pattern of one row, and of its values for the value-aware metrics (serial: called per
+// row from parallel loops)
+template<typename CSR>
+int64_t csr_row_hash(const CSR& mat, size_t row, bool with_values)
+{
+    using IndexType  = typename CSR::index_type;
+    using ValueType  = typename CSR::value_type;
+    const auto begin = mat.row_pointers[row];
+    const auto end   = mat.row_pointers[row + 1];
+    uint64_t   hash  = hash_block(reinterpret_cast<const unsigned char*>(mat.column_indices.data() + begin),
+                               (end - begin) * sizeof(IndexType),
+                               end - begin);
+    if (with_values) {
+        hash = hash_combine(hash,
+                            hash_block(reinterpret_cast<const unsigned char*>(mat.values.data() + begin),
+                                       (end - begin) * sizeof(ValueType),
+                                       end - begin));
+    }
+    return hash;
+}
+
+class IncrementalReorderer {
+public:
+    using KnnGraph = CsrMatrix<unsigned, float, host_memory>;
+
+    explicit IncrementalReorderer(const ReorderOptions&     options     = ReorderOptions(),
+                                  const IncrementalOptions& incremental = IncrementalOptions()):
+        options(options), incremental(incremental)
+    {
+    }
+
+    size_t num_rows() const
+    {
+        return order.size();
+    }
+
+    // Full pipeline on a host matrix; keeps the state for update()
+    template<typename CSR, typename Vector>
+    ReorderStats initialize(const CSR& mat, Vector& new_ids)
+    {
+        static_assert(std::is_same_v<typename CSR::memory_space, host_memory>,
+                      "incremental reordering needs a host matrix");
+
+        // a cached permutation would skip the KNN graph and the forest kept here, and a budget could pad it
+        ReorderOptions full = options;
+        full.cache_dir.clear();
+        full.time_budget_ms = 0;
+        Reorderer  reorderer(full);
+        const auto stats = reorderer.compute(mat, new_ids);
+        const auto nrow  = mat.num_rows;
+
+        knn = reorderer.knn_graph();
+        k   = nrow > 0 ? knn.row_pointers[1] - knn.row_pointers[0] : 0;
+        sort_knn_rows(knn);  // insert() keeps the lists sorted
+
+        forest.assign(nrow, {});
+        for (const auto& [u, adjs] : reorderer.spanning_forest().adjs) {
+            for (const auto v : adjs) {
+                forest[u].emplace_back(v, csr_row_distance(mat, u, v, options.knn_metric, options.knn_block_cols));
+            }
+        }
+
+        order.resize(nrow);
+        removed.assign(nrow, 0);
+        row_hashes.resize(nrow);
+#pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < int64_t(nrow); i++) {
+            order[new_ids[i]] = i;
+            row_hashes[i]     = csr_row_hash(mat, i, is_value_aware(options.knn_metric));
+        }
+        tombstones = 0;
+        return stats;
+    }
+
+    // Delta between the matrix the state describes and `mat`, from the per-row hashes (pattern, and values
+    // for the value-aware metrics)
+    template<typename CSR>
+    MatrixDelta diff(const CSR& mat) const
+    {
+        const size_t old_rows = order.size();
+        ASSERT(size_t(mat.num_rows) >= old_rows);
+
+        // hash in parallel, then collect in row order
+        enum : uint8_t { same = 0, added, changed, dropped };
+        std::vector<uint8_t> kind(old_rows);
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (int64_t i = 0; i < int64_t(old_rows); i++) {
+            const bool empty = mat.row_pointers[i] == mat.row_pointers[i + 1];
+            if (removed[i]) {
+                kind[i] = empty ? same : added;
+            }
+            else if (csr_row_hash(mat, i, is_value_aware(options.knn_metric)) != row_hashes[i]) {
+                kind[i] = empty ? dropped : changed;
+            }
+            else {
+                kind[i] = same;
+            }
+        }
+
+        MatrixDelta delta;
+        for (size_t i = 0; i < old_rows; i++) {
+            if (kind[i] == added) {
+                delta.added.push_back(i);
+            }
+            else if (kind[i] == changed) {
+                delta.changed.push_back(i);
+            }
+            else if (kind[i] == dropped) {
+                delta.removed.push_back(i);
+            }
+        }
+        for (size_t i = old_rows; i < size_t(mat.num_rows); i++) {
+            delta.added.push_back(i);
+        }
+        return delta;
+    }
+
+    template<typename CSR, typename Vector>
+    IncrementalStats update(const CSR& mat, const MatrixDelta& delta, Vector& new_ids)
+    {
+        static_assert(std::is_same_v<typename CSR::memory_space, host_memory>,
+                      "incremental reordering needs a host matrix");
+
+        IncrementalStats stats;
+        CPUTimer         total, timer;
+        TraceScope       scope("incremental");
+        total.start();
+
+        const size_t old_rows = order.size();
+        const size_t new_rows = mat.num_rows;
+        ASSERT(new_rows >= old_rows);
+
+        // appended rows are implied; changes to rows that are added or removed in the same delta are dropped
+        std::unordered_set<unsigned> added_set(delta.added.begin(), delta.added.end());
+        std::vector<unsigned>        added(delta.added.begin(), delta.added.end()), changed, dropped;
+        for (size_t i = old_rows; i < new_rows; i++) {
+            if (added_set.insert(i).second) {
+                added.push_back(i);
+            }
+        }
+        std::unordered_set<unsigned> removed_set;
+        for (const auto r : delta.removed) {
+            ASSERT(r < old_rows);
+            if (!removed[r] && !added_set.count(r) && removed_set.insert(r).second) {
+                dropped.push_back(r);
+            }
+        }
+        for (const auto a : delta.changed) {
+            ASSERT(a < old_rows);
+            if (!removed[a] && !added_set.count(a) && !removed_set.count(a)) {
+                changed.push_back(a);
+            }
+        }
+        std::sort(added.begin(), added.end());
+        added.erase(std::unique(added.begin(), added.end()), added.end());
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+        for (const auto a : added) {
+            ASSERT(a < new_rows && (a >= old_rows || removed[a]));
+        }
+        stats.added   = added.size();
+        stats.changed = changed.size();
+        stats.removed = dropped.size();
+
+        std::vector<unsigned> affected(changed);
+        affected.insert(affected.end(), added.begin(), added.end());
+
+        grow(new_rows);
+        for (const auto a : added) {
+            removed[a] = 0;
+        }
+        for (const auto r : dropped) {
+            removed[r] = 1;
+        }
+
+        // KNN lists
+        timer.start();
+        for (const auto r : dropped) {
+            // rows that listed r are most likely among its own neighbors
+            for (unsigned s = 0; s < k; s++) {
+                const unsigned c = slots(r)[s];
+                if (c != invalid_row) {
+                    stats.lists_updated += drop(c, r);
+                }
+            }
+            clear_list(r);
+        }
+        for (const auto a : affected) {
+            descend(mat, a, stats);
+        }
+        timer.stop();
+        stats.knn_ms = timer.elapsed();
+
+        // spanning forest
+        timer.start();
+        for (const auto r : dropped) {
+            reconnect_neighbors(mat, r, stats);
+        }
+        for (const auto a : changed) {
+            for (auto& [b, w] : forest[a]) {
+                w = csr_row_distance(mat, a, b, options.knn_metric, options.knn_block_cols);
+                set_weight(b, a, w);
+                stats.distance_evaluations++;
+            }
+        }
+        for (const auto a : added) {
+            forest[a].clear();
+            for (unsigned s = 0; s < k; s++) {
+                const unsigned b = slots(a)[s];
+                if (b != invalid_row && !removed[b]) {
+                    add_edge(a, b, distances(a)[s]);
+                    break;
+                }
+            }
+        }
+        for (const auto a : affected) {
+            for (unsigned s = 0; s < k; s++) {
+                const unsigned b = slots(a)[s];
+                if (b != invalid_row && !removed[b]) {
+                    stats.edges_replaced += insert_tree_edge(a, b, distances(a)[s]);
+                }
+            }
+        }
+        timer.stop();
+        stats.mst_ms = timer.elapsed();
+
+        // splice into the order
+        timer.start();
+        splice(added, affected, added_set, stats);
+        new_ids.resize(new_rows);
+#pragma omp parallel for schedule(static)
+        for (int64_t pos = 0; pos < int64_t(new_rows); pos++) {
+            new_ids[order[pos]] = pos;
+        }
+        for (const auto a : affected) {
+            row_hashes[a] = csr_row_hash(mat, a, is_value_aware(options.knn_metric));
+        }
+        for (const auto r : dropped) {
+            row_hashes[r] = csr_row_hash(mat, r, is_value_aware(options.knn_metric));
+        }
+        timer.stop();
+        stats.dfs_ms     = timer.elapsed();
+        stats.tombstones = tombstones;
+
+        total.stop();
+        stats.total_ms = total.elapsed();
+        scope.counter("affected_rows", affected.size() + dropped.size());
+        scope.counter("distance_evaluations", stats.distance_evaluations);
+        scope.counter("edges_replaced", stats.edges_replaced);
+        return stats;
+    }
+
+    // <directory>/knn.gcsr, forest.gcsr, order.garr (tag: tombstones), rows.garr (tag: KNN slots per row),
+    // params.garr (what the distances depend on, see state_params)
+    bool save(const std::string& directory) const
+    {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+
+        const size_t nrow = order.size();
+        KnnGraph     tree(nrow, nrow, 0);
+        for (size_t u = 0; u < nrow; u++) {
+            tree.row_pointers[u + 1] = tree.row_pointers[u] + forest[u].size();
+        }
+        tree.resize(nrow, nrow, tree.row_pointers[nrow]);
+        for (size_t u = 0; u < nrow; u++) {
+            auto j = tree.row_pointers[u];
+            for (const auto& [v, w] : forest[u]) {
+                tree.column_indices[j] = v;
+                tree.values[j++]       = w;
+            }
+        }
+
+        const std::filesystem::path dir(directory);
+        return write_into_gcsr(knn, (dir / "knn.gcsr").string())
+               && write_into_gcsr(tree, (dir / "forest.gcsr").string())
+               && write_into_garray(order, (dir / "order.garr").string(), tombstones)
+               && write_into_garray(row_hashes, (dir / "rows.garr").string(), k)
+               && write_into_garray(state_params(), (dir / "params.garr").string());
+    }
+
+    bool load(const std::string& directory)
+    {
+        const std::filesystem::path dir(directory);
+        for (const char* name : {"knn.gcsr", "forest.gcsr", "order.garr", "rows.garr", "params.garr"}) {
+            if (!std::filesystem::exists(dir / name)) {
+                return false;
+            }
+        }
+        HostVector<uint64_t> params;
+        if (!read_from_garray(params, (dir / "params.garr").string()) || params != state_params()) {
+            std::cout << "incremental state was built with other KNN parameters!" << std::endl;
+            return false;
+        }
+        KnnGraph tree;
+        uint64_t tombstone_count = 0, slots_per_row = 0;
+        if (!read_from_gcsr(knn, (dir / "knn.gcsr").string()) || !read_from_gcsr(tree, (dir / "forest.gcsr").string())
+            || !read_from_garray(order, (dir / "order.garr").string(), &tombstone_count)
+            || !read_from_garray(row_hashes, (dir / "rows.garr").string(), &slots_per_row)) {
+            return false;
+        }
+        const size_t nrow = order.size();
+        if (size_t(knn.num_rows) != nrow || size_t(tree.num_rows) != nrow || row_hashes.size() != nrow
+            || tombstone_count > nrow || size_t(knn.num_entries) != nrow * slots_per_row || !valid_ids(tree, nrow)) {
+            std::cout << "incremental state is inconsistent!" << std::endl;
+            return false;
+        }
+        k          = slots_per_row;
+        tombstones = tombstone_count;
+
+        forest.assign(nrow, {});
+        for (size_t u = 0; u < nrow; u++) {
+            for (auto j = tree.row_pointers[u]; j < tree.row_pointers[u + 1]; j++) {
+                forest[u].emplace_back(tree.column_indices[j], tree.values[j]);
+            }
+        }
+        removed.assign(nrow, 0);
+        for (size_t pos = nrow - tombstones; pos < nrow; pos++) {
+            removed[order[pos]] = 1;
+        }
+        return true;
+    }
+
+private:
+    using Forest = std::vector<std::vector<std::pair<unsigned, float>>>;
+
+    // Ids read back by load() that later index arrays of nrow: KNN slots below nrow (or invalid_row), forest
+    // rows well formed with neighbors below nrow, and `order` a permutation. A stale or corrupt state fails.
+    bool valid_ids(const KnnGraph& tree, size_t nrow) const
+    {
+        const int64_t slots_total = knn.num_entries;
+        bool          bad         = false;
+#pragma omp parallel for reduction(|| : bad)
+        for (int64_t j = 0; j < slots_total; j++) {
+            bad = bad || (knn.column_indices[j] >= nrow && knn.column_indices[j] != invalid_row);
+        }
+        for (size_t u = 0; u < nrow && !bad; u++) {
+            bad = tree.row_pointers[u] > tree.row_pointers[u + 1];
+        }
+        if (bad || tree.row_pointers[0] != 0 || size_t(tree.row_pointers[nrow]) != size_t(tree.num_entries)
+            || !all_below(tree.column_indices, nrow) || !all_below(order, nrow)) {
+            return false;
+        }
+        std::vector<uint8_t> seen(nrow, 0);
+        for (const auto row : order) {
+            if (seen[row]++) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Options the saved distances and lists depend on; a state saved with others is not loaded
+    HostVector<uint64_t> state_params() const
+    {
+        HostVector<uint64_t> params(4);
+        params[0] = uint64_t(options.knn_metric);
+        params[1] = options.knn_block_cols;
+        params[2] = options.knn_k;
+        params[3] = options.knn_l;
+        return params;
+    }
+
+    unsigned* slots(unsigned row)
+    {
+        return knn.column_indices.data() + size_t(row) * k;
+    }
+
+    float* distances(unsigned row)
+    {
+        return knn.values.data() + size_t(row) * k;
+    }
+
+    // new rows get empty KNN lists; capacity grows geometrically so appending rows stays amortized
+    void grow(size_t new_rows)
+    {
+        const size_t old_rows = order.size();
+        if (new_rows == old_rows) {
+            return;
+        }
+        const size_t slot_count = new_rows * k;
+        if (slot_count > knn.column_indices.capacity()) {
+            knn.column_indices.reserve(slot_count + slot_count / 4);
+            knn.values.reserve(slot_count + slot_count / 4);
+        }
+        knn.resize(new_rows, new_rows, slot_count);
+        for (size_t i = old_rows; i < new_rows; i++) {
+            knn.row_pointers[i + 1] = (i + 1) * k;
+            clear_list(i);
+        }
+        forest.resize(new_rows);
+        order.resize(new_rows, invalid_row);
+        removed.resize(new_rows, 0);
+        row_hashes.resize(new_rows);
+    }
+
+    void clear_list(unsigned row)
+    {
+        std::fill_n(slots(row), k, invalid_row);
+        std::fill_n(distances(row), k, std::numeric_limits<float>::infinity());
+    }
+
+    void remove_slot(unsigned row, unsigned s)
+    {
+        unsigned* ids = slots(row);
+        float*    ds  = distances(row);
+        std::copy(ids + s + 1, ids + k, ids + s);
+        std::copy(ds + s + 1, ds + k, ds + s);
+        ids[k - 1] = invalid_row;
+        ds[k - 1]  = std::numeric_limits<float>::infinity();
+    }
+
+    // put `col` into the sorted list of `row` (or move it there, if it is listed with another distance)
+    bool insert(unsigned row, unsigned col, float distance)
+    {
+        unsigned* ids = slots(row);
+        float*    ds  = distances(row);
+        for (unsigned s = 0; s < k; s++) {
+            if (ids[s] == col) {
+                if (ds[s] == distance) {
+                    return false;
+                }
+                remove_slot(row, s);
+                break;
+            }
+        }
+        unsigned pos = 0;
+        const auto key = std::make_pair(distance, col);
+        while (pos < k && ids[pos] != invalid_row && std::make_pair(ds[pos], ids[pos]) < key) {
+            pos++;
+        }
+        if (pos == k) {
+            return false;
+        }
+        std::copy_backward(ids + pos, ids + k - 1, ids + k);
+        std::copy_backward(ds + pos, ds + k - 1, ds + k);
+        ids[pos] = col;
+        ds[pos]  = distance;
+        return true;
+    }
+
+    bool drop(unsigned row, unsigned col)
+    {
+        const unsigned* ids = slots(row);
+        for (unsigned s = 0; s < k; s++) {
+            if (ids[s] == col) {
+                remove_slot(row, s);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // local NN-descent for `row`: its old list and its column ids seed the search, then neighbors of neighbors
+    template<typename CSR>
+    void descend(const CSR& mat, unsigned row, IncrementalStats& stats)
+    {
+        const size_t          nrow = mat.num_rows;
+        std::vector<unsigned> frontier(slots(row), slots(row) + k);
+        for (auto j = mat.row_pointers[row]; j < mat.row_pointers[row + 1]; j++) {
+            if (size_t(mat.column_indices[j]) < nrow) {
+                frontier.push_back(mat.column_indices[j]);
+            }
+        }
+        if (std::none_of(frontier.begin(), frontier.end(), [&](unsigned c) { return c != invalid_row; })) {
+            // nothing to start from: a few pseudo-random rows
+            for (unsigned t = 0; t < std::max(k, 1u); t++) {
+                frontier.push_back(random_below(options.seed, row, t, nrow));
+            }
+        }
+        clear_list(row);
+
+        std::unordered_set<unsigned> seen{row};
+        for (unsigned round = 0; round <= incremental.descent_rounds && !frontier.empty(); round++) {
+            for (const auto c : frontier) {
+                if (c == invalid_row || removed[c] || !seen.insert(c).second) {
+                    continue;
+                }
+                const float distance = csr_row_distance(mat, row, c, options.knn_metric, options.knn_block_cols);
+                stats.distance_evaluations++;
+                insert(row, c, distance);
+                stats.lists_updated += insert(c, row, distance);
+            }
+            std::vector<unsigned> next;
+            for (unsigned s = 0; s < k && slots(row)[s] != invalid_row; s++) {
+                const unsigned* ids = slots(slots(row)[s]);
+                for (unsigned t = 0; t < k && ids[t] != invalid_row; t++) {
+                    if (!seen.count(ids[t])) {
+                        next.push_back(ids[t]);
+                    }
+                }
+            }
+            frontier.swap(next);
+        }
+    }
+
+    void add_edge(unsigned u, unsigned v, float w)
+    {
+        forest[u].emplace_back(v, w);
+        forest[v].emplace_back(u, w);
+    }
+
+    void remove_half_edge(unsigned u, unsigned v)
+    {
+        auto& adjs = forest[u];
+        adjs.erase(std::find_if(adjs.begin(), adjs.end(), [v](const auto& e) { return e.first == v; }));
+    }
+
+    void set_weight(unsigned u, unsigned v, float w)
+    {
+        for (auto& e : forest[u]) {
+            if (e.first == v) {
+                e.second = w;
+            }
+        }
+    }
+
+    // Reconnect the subtrees hanging off a removed row: exact MST among its first max_reconnect tree
+    // neighbors, the others attach to the nearest of those
+    template<typename CSR>
+    void reconnect_neighbors(const CSR& mat, unsigned row, IncrementalStats& stats)
+    {
+        std::vector<unsigned> nbrs;
+        for (const auto& [v, w] : forest[row]) {
+            nbrs.push_back(v);
+            remove_half_edge(v, row);
+        }
+        forest[row].clear();
+
+        const size_t exact = std::min<size_t>(nbrs.size(), incremental.max_reconnect);
+        std::vector<std::tuple<float, unsigned, unsigned>> edges;
+        for (size_t i = 0; i < exact; i++) {
+            for (size_t j = 0; j < i; j++) {
+                const float w = csr_row_distance(mat, nbrs[i], nbrs[j], options.knn_metric, options.knn_block_cols);
+                edges.emplace_back(w, j, i);
+            }
+        }
+        stats.distance_evaluations += edges.size();
+        std::sort(edges.begin(), edges.end());
+
+        std::vector<size_t> parents(exact);
+        std::iota(parents.begin(), parents.end(), 0);
+        auto find = [&parents](size_t i) {
+            while (parents[i] != i) {
+                i = parents[i] = parents[parents[i]];
+            }
+            return i;
+        };
+        for (const auto& [w, i, j] : edges) {
+            if (find(i) != find(j)) {
+                parents[find(i)] = find(j);
+                add_edge(nbrs[i], nbrs[j], w);
+            }
+        }
+        for (size_t i = exact; i < nbrs.size(); i++) {
+            size_t best   = 0;
+            float  best_w = std::numeric_limits<float>::infinity();
+            for (size_t j = 0; j < exact; j++) {
+                const float w = csr_row_distance(mat, nbrs[i], nbrs[j], options.knn_metric, options.knn_block_cols);
+                if (w < best_w) {
+                    best   = j;
+                    best_w = w;
+                }
+            }
+            stats.distance_evaluations += exact;
+            add_edge(nbrs[i], nbrs[best], best_w);
+        }
+    }
+
+    // Cycle property: edge (u, v) replaces the heaviest edge on the tree path between u and v if it is lighter,
+    // and links u and v if they are in different trees. The path search visits at most max_path_search nodes.
+    bool insert_tree_edge(unsigned u, unsigned v, float w)
+    {
+        for (const auto& e : forest[u]) {
+            if (e.first == v) {
+                return false;
+            }
+        }
+        std::unordered_map<unsigned, std::pair<unsigned, float>> parent{{u, {u, 0.0f}}};  // node -> (parent, weight)
+        std::vector<unsigned>                                    queue{u};
+        size_t                                                   head = 0;
+        for (; head < queue.size() && !parent.count(v) && parent.size() < incremental.max_path_search; head++) {
+            for (const auto& [next, weight] : forest[queue[head]]) {
+                if (parent.emplace(next, std::make_pair(queue[head], weight)).second) {
+                    queue.push_back(next);
+                }
+            }
+        }
+        if (!parent.count(v)) {
+            if (head < queue.size()) {
+                return false;  // too far away to tell
+            }
+            add_edge(u, v, w);  // different trees
+            return false;
+        }
+
+        unsigned heavy_u = invalid_row, heavy_v = invalid_row;
+        float    heavy_w = -std::numeric_limits<float>::infinity();
+        for (unsigned x = v; x != u;) {
+            const auto [p, weight] = parent[x];
+            if (weight > heavy_w) {
+                heavy_u = p;
+                heavy_v = x;
+                heavy_w = weight;
+            }
+            x = p;
+        }
+        if (heavy_w <= w) {
+            return false;
+        }
+        remove_half_edge(heavy_u, heavy_v);
+        remove_half_edge(heavy_v, heavy_u);
+        add_edge(u, v, w);
+        return true;
+    }
+
+    // Place every affected row right after its lightest tree neighbor that already has a place; changed rows
+    // without one keep their position, added rows without one go after the live rows. Tombstones go last.
+    void splice(const std::vector<unsigned>&        added,
+                const std::vector<unsigned>&        affected,
+                const std::unordered_set<unsigned>& added_set,
+                IncrementalStats&                   stats)
+    {
+        std::unordered_set<unsigned>                         pending(affected.begin(), affected.end());
+        std::unordered_set<unsigned>                         spliced;
+        std::unordered_map<unsigned, std::vector<unsigned>> children;  // anchor -> rows placed after it
+        for (const auto a : affected) {
+            unsigned anchor = invalid_row;
+            float    best   = std::numeric_limits<float>::infinity();
+            for (const auto& [b, w] : forest[a]) {
+                if (!removed[b] && !pending.count(b) && (w < best || (w == best && b < anchor))) {
+                    anchor = b;
+                    best   = w;
+                }
+            }
+            pending.erase(a);
+            if (anchor != invalid_row) {
+                children[anchor].push_back(a);
+                spliced.insert(a);
+            }
+        }
+        stats.rows_spliced = spliced.size();
+
+        HostVector<unsigned>  next_order;
+        std::vector<unsigned> tail;
+        next_order.reserve(order.size());
+        auto emit = [&](unsigned row) {
+            std::vector<unsigned> stack{row};
+            while (!stack.empty()) {
+                const unsigned r = stack.back();
+                stack.pop_back();
+                next_order.push_back(r);
+                if (auto it = children.find(r); it != children.end()) {
+                    stack.insert(stack.end(), it->second.rbegin(), it->second.rend());
+                }
+            }
+        };
+        for (const auto row : order) {
+            if (row == invalid_row || (!spliced.empty() && spliced.count(row))
+                || (!added_set.empty() && added_set.count(row))) {
+                continue;
+            }
+            if (removed[row]) {
+                tail.push_back(row);
+                continue;
+            }
+            emit(row);
+        }
+        for (const auto a : added) {
+            if (!spliced.count(a)) {
+                emit(a);
+            }
+        }
+        tombstones = tail.size();
+        next_order.insert(next_order.end(), tail.begin(), tail.end());
+        ASSERT(next_order.size() == order.size());
+        order.swap(next_order);
+    }
+
+    ReorderOptions     options;
+    IncrementalOptions incremental;
+
+    unsigned             k = 0;       // KNN slots per row; unused slots hold invalid_row
+    KnnGraph             knn;         // row i: slots [i * k, (i + 1) * k), sorted by (distance, id)
+    Forest               forest;      // weighted adjacency of the spanning forest
+    HostVector<unsigned> order;       // order[position] = row, tombstones last
+    std::vector<char>    removed;     // tombstone flags
+    HostVector<int64_t>  row_hashes;  // csr_row_hash per row, for diff()
+    size_t               tombstones = 0;
+};
+
+inline void print_incremental_stats(const IncrementalStats& stats)
+{
+    printf("[incremental] rows added: %zu, changed: %zu, removed: %zu, tombstones: %zu\n",
+           stats.added,
+           stats.changed,
+           stats.removed,
+           stats.tombstones);
+    printf("[incremental] distance evaluations: %zu, lists updated: %zu, tree edges replaced: %zu, rows spliced: %zu\n",
+           stats.distance_evaluations,
+           stats.lists_updated,
+           stats.edges_replaced,
+           stats.rows_spliced);
+    printf("[incremental] time (ms): KNN %f, MST %f, DFS %f, total %f\n",
+           stats.knn_ms,
+           stats.mst_ms,
+           stats.dfs_ms,
+           stats.total_ms);
+}
+
+// Update the state kept in `directory` with the delta to `mat`, or start it with a full run
+template<typename CSR, typename Vector>
+void reorder_incremental(const ReorderOptions& options, const std::string& directory, const CSR& mat, Vector& new_ids)
+{
+    if constexpr (!std::is_same_v<typename CSR::memory_space, host_memory>) {
+        CsrMatrix<typename CSR::index_type, typename CSR::value_type, host_memory> host;
+        host.num_rows       = mat.num_rows;
+        host.num_cols       = mat.num_cols;
+        host.num_entries    = mat.num_entries;
+        host.row_pointers   = mat.row_pointers;
+        host.column_indices = mat.column_indices;
+        host.values         = mat.values;
+        reorder_incremental(options, directory, host, new_ids);
+    }
+    else {
+        IncrementalReorderer reorderer(options);
+        if (reorderer.load(directory) && reorderer.num_rows() <= size_t(mat.num_rows)) {
+            print_incremental_stats(reorderer.update(mat, reorderer.diff(mat), new_ids));
+        }
+        else {
+            printf("[incremental] no usable state in %s, running the full pipeline\n", directory.c_str());
+            print_reorder_stats(reorderer.initialize(mat, new_ids));
+        }
+        if (!reorderer.save(directory)) {
+            printf("cannot save the incremental state: %s\n", directory.c_str());
+        }
+    }
+}
+
+}  // namespace groot
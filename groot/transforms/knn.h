@@ -3,10 +3,14 @@
 
 // C++ Standard Library
 #include <algorithm>
+#include <bit>
 #include <cmath>
+#include <numeric>
+#include <optional>
 #include <queue>
 #include <set>
 #include <stack>
+#include <string>
 #include <string_view>
 #include <unordered_set>
 #include <utility>
@@ -20,9 +24,6 @@ namespace groot {
 template<typename T>
 using AdjVector = thrust::host_vector<thrust::host_vector<T>>;
 
-template<typename T>
-using AdjOracle = kgraph::VectorOracle<AdjVector<T>, thrust::host_vector<T>>;
-
 template<typename T>
 using AdjHash = std::unordered_map<int, std::vector<T>>;
 
@@ -65,11 +66,327 @@ auto sparse_hamming_distance = [](const thrust::host_vector<int>& a, const thrus
     return distance;
 };
 
+// Distance between two rows that the KNN graph is built with (KnnMetric):
+//   Hamming          |a| + |b| - 2 |a & b|             (pattern; favors pairing short rows)
+//   Jaccard          1 - |a & b| / |a | b|             (pattern)
+//   Overlap          1 - |a & b| / min(|a|, |b|)       (pattern; a row close to its supersets)
+//   WeightedHamming  sum over a | b of |a_j - b_j|     (values, missing entries are 0)
+//   Cosine           1 - a.b / (||a|| ||b||)           (values)
+//   Blocks           Hamming over the column blocks    (pattern; blocks of block_cols columns, one per tile
+//                                                       column of a tensor-core SpMM, see BlockOracle)
+enum class KnnMetric { Hamming = 0, Jaccard, Overlap, WeightedHamming, Cosine, Blocks };
+
+// names used by -M
+inline const char* knn_metric_to_string(KnnMetric metric)
+{
+    switch (metric) {
+        case KnnMetric::Hamming:
+            return "hamming";
+        case KnnMetric::Jaccard:
+            return "jaccard";
+        case KnnMetric::Overlap:
+            return "overlap";
+        case KnnMetric::WeightedHamming:
+            return "weighted-hamming";
+        case KnnMetric::Cosine:
+            return "cosine";
+        case KnnMetric::Blocks:
+            return "blocks";
+        default:
+            return "unknown";
+    }
+}
+
+inline bool parse_knn_metric(const std::string& name, KnnMetric& metric)
+{
+    for (auto m : {KnnMetric::Hamming, KnnMetric::Jaccard, KnnMetric::Overlap, KnnMetric::WeightedHamming,
+                   KnnMetric::Cosine, KnnMetric::Blocks}) {
+        if (name == knn_metric_to_string(m)) {
+            metric = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Metrics that read the values, not only the pattern
+constexpr bool is_value_aware(KnnMetric metric)
+{
+    return metric == KnnMetric::WeightedHamming || metric == KnnMetric::Cosine;
+}
+
+// Per-row term of the value-aware metrics: sum |v| (weighted Hamming) or ||v|| (cosine); 0 otherwise
+template<typename V>
+inline float row_norm(KnnMetric metric, const V* values, size_t n)
+{
+    float norm = 0;
+    if (metric == KnnMetric::WeightedHamming) {
+        for (size_t i = 0; i < n; i++) {
+            norm += std::fabs(values[i]);
+        }
+    }
+    else if (metric == KnnMetric::Cosine) {
+        for (size_t i = 0; i < n; i++) {
+            norm += values[i] * values[i];
+        }
+        norm = std::sqrt(norm);
+    }
+    return norm;
+}
+
+// What two sorted rows have in common. `shared` is sum |a_j| + |b_j| - |a_j - b_j| and `dot` is sum a_j b_j
+// over the common columns j (only with Weighted).
+struct RowOverlap {
+    float common = 0;
+    float shared = 0;
+    float dot    = 0;
+};
+
+// Branchless merge: both cursors advance by comparison results, so random column patterns compile to
+// conditional moves instead of mispredicted branches.
+template<bool Weighted, typename T, typename V>
+inline RowOverlap intersect_rows(const T* a, const V* va, size_t na, const T* b, const V* vb, size_t nb)
+{
+    RowOverlap overlap;
+    size_t     i = 0, j = 0;
+    while (i < na && j < nb) {
+        const T    x  = a[i];
+        const T    y  = b[j];
+        const bool eq = x == y;
+        if constexpr (Weighted) {
+            const float p = va[i], q = vb[j];
+            overlap.shared += eq ? std::fabs(p) + std::fabs(q) - std::fabs(p - q) : 0.0f;
+            overlap.dot += eq ? p * q : 0.0f;
+        }
+        overlap.common += eq;
+        i += x <= y;
+        j += y <= x;
+    }
+    return overlap;
+}
+
+// Distance from the row sizes, the row norms (row_norm) and the overlap of the two rows
+template<KnnMetric Metric>
+inline float row_distance(size_t na, size_t nb, float norm_a, float norm_b, const RowOverlap& overlap)
+{
+    const float c = overlap.common;
+    if constexpr (Metric == KnnMetric::Hamming) {
+        return float(na + nb) - 2 * c;
+    }
+    else if constexpr (Metric == KnnMetric::Jaccard) {
+        const float all = float(na + nb) - c;
+        return all > 0 ? 1 - c / all : 0.0f;
+    }
+    else if constexpr (Metric == KnnMetric::Overlap) {
+        const size_t least = std::min(na, nb);
+        return least > 0 ? 1 - c / least : float(na != nb);
+    }
+    else if constexpr (Metric == KnnMetric::WeightedHamming) {
+        return std::max(0.0f, norm_a + norm_b - overlap.shared);
+    }
+    else {
+        return norm_a > 0 && norm_b > 0 ? std::clamp(1 - overlap.dot / (norm_a * norm_b), 0.0f, 2.0f)
+                                        : float(norm_a != norm_b);
+    }
+}
+
+// Column blocks (column / block_cols) touched by exactly one of two sorted rows
+template<typename T>
+inline float block_distance(const T* a, size_t na, const T* b, size_t nb, unsigned block_cols)
+{
+    size_t i = 0, j = 0, blocks = 0, shared = 0;
+    while (i < na || j < nb) {
+        const int64_t x     = i < na ? int64_t(a[i] / block_cols) : std::numeric_limits<int64_t>::max();
+        const int64_t y     = j < nb ? int64_t(b[j] / block_cols) : std::numeric_limits<int64_t>::max();
+        const int64_t block = std::min(x, y);
+        blocks += (x == block) + (y == block);
+        shared += x == y;
+        while (i < na && int64_t(a[i] / block_cols) == block) {
+            i++;
+        }
+        while (j < nb && int64_t(b[j] / block_cols) == block) {
+            j++;
+        }
+    }
+    return float(blocks - 2 * shared);
+}
+
+// Distance between two sorted rows, with their values when the metric needs them (norms computed here)
+template<typename T, typename V>
+inline float row_distance(KnnMetric metric,
+                          const T*  a,
+                          const V*  va,
+                          size_t    na,
+                          const T*  b,
+                          const V*  vb,
+                          size_t    nb,
+                          unsigned  block_cols = 8)
+{
+    if (metric == KnnMetric::Blocks) {
+        return block_distance(a, na, b, nb, block_cols);
+    }
+    if (is_value_aware(metric)) {
+        const auto  overlap = intersect_rows<true>(a, va, na, b, vb, nb);
+        const float norm_a = row_norm(metric, va, na), norm_b = row_norm(metric, vb, nb);
+        return metric == KnnMetric::Cosine ? row_distance<KnnMetric::Cosine>(na, nb, norm_a, norm_b, overlap)
+                                           : row_distance<KnnMetric::WeightedHamming>(na, nb, norm_a, norm_b, overlap);
+    }
+    const auto overlap = intersect_rows<false>(a, va, na, b, vb, nb);
+    switch (metric) {
+        case KnnMetric::Jaccard:
+            return row_distance<KnnMetric::Jaccard>(na, nb, 0, 0, overlap);
+        case KnnMetric::Overlap:
+            return row_distance<KnnMetric::Overlap>(na, nb, 0, 0, overlap);
+        default:
+            return row_distance<KnnMetric::Hamming>(na, nb, 0, 0, overlap);
+    }
+}
+
+// kgraph oracle over the rows of `graph`. `values` (same shape) is only read by the value-aware metrics,
+// whose row norms are computed once here. `evaluations` (padded per thread) counts distance calls if given.
+template<KnnMetric Metric>
+class RowOracle: public kgraph::IndexOracle {
+public:
+    RowOracle(const AdjVector<int>& graph, const AdjVector<float>* values, std::vector<uint64_t>* evaluations):
+        graph(graph), values(values), evaluations(evaluations)
+    {
+        ASSERT(!is_value_aware(Metric) || (values && values->size() == graph.size()));
+        if constexpr (is_value_aware(Metric)) {
+            norms.resize(graph.size());
+#pragma omp parallel for
+            for (size_t i = 0; i < graph.size(); i++) {
+                norms[i] = row_norm(Metric, (*values)[i].data(), (*values)[i].size());
+            }
+        }
+    }
+
+    unsigned size() const override
+    {
+        return graph.size();
+    }
+
+    float operator()(unsigned i, unsigned j) const override
+    {
+        if (evaluations) {
+            (*evaluations)[8 * omp_get_thread_num()]++;
+        }
+        const auto& a = graph[i];
+        const auto& b = graph[j];
+        if constexpr (is_value_aware(Metric)) {
+            const auto overlap =
+                intersect_rows<true>(a.data(), (*values)[i].data(), a.size(), b.data(), (*values)[j].data(), b.size());
+            return row_distance<Metric>(a.size(), b.size(), norms[i], norms[j], overlap);
+        }
+        else {
+            const auto overlap =
+                intersect_rows<false, int, float>(a.data(), nullptr, a.size(), b.data(), nullptr, b.size());
+            return row_distance<Metric>(a.size(), b.size(), 0, 0, overlap);
+        }
+    }
+
+private:
+    const AdjVector<int>&   graph;
+    const AdjVector<float>* values;
+    std::vector<uint64_t>*  evaluations;
+    std::vector<float>      norms;
+};
+
+// kgraph oracle for KnnMetric::Blocks. Every row is turned once (in parallel) into a bitmap of the column
+// blocks it touches, stored sparsely as (word, bits) pairs of 64 blocks each, in increasing word order.
+// The distance |A ^ B| = |A| + |B| - 2 |A & B| then only needs the AND of the words both rows have:
+// a branchless merge over words and one popcount per common word, instead of a merge over columns.
+class BlockOracle: public kgraph::IndexOracle {
+public:
+    BlockOracle(const AdjVector<int>& graph, unsigned block_cols, std::vector<uint64_t>* evaluations):
+        evaluations(evaluations)
+    {
+        const size_t nrow = graph.size();
+        row_ptr.resize(nrow + 1);
+        blocks.resize(nrow);
+
+        // words per row, then fill (rows are sorted, so their blocks and words are too)
+        auto for_each_word = [&](size_t i, auto&& visit) {
+            uint64_t word = std::numeric_limits<uint64_t>::max(), bits = 0;
+            for (const auto c : graph[i]) {
+                const uint64_t block = unsigned(c) / block_cols;
+                if (block / 64 != word) {
+                    if (bits) {
+                        visit(word, bits);
+                    }
+                    word = block / 64;
+                    bits = 0;
+                }
+                bits |= uint64_t(1) << (block % 64);
+            }
+            if (bits) {
+                visit(word, bits);
+            }
+        };
+        row_ptr[0] = 0;
+#pragma omp parallel for schedule(dynamic, 256)
+        for (size_t i = 0; i < nrow; i++) {
+            size_t count = 0, total = 0;
+            for_each_word(i, [&](uint64_t, uint64_t bits) {
+                count++;
+                total += std::popcount(bits);
+            });
+            row_ptr[i + 1] = count;
+            blocks[i]      = total;
+        }
+        std::partial_sum(row_ptr.begin(), row_ptr.end(), row_ptr.begin());
+
+        words.resize(row_ptr[nrow]);
+        bits.resize(row_ptr[nrow]);
+#pragma omp parallel for schedule(dynamic, 256)
+        for (size_t i = 0; i < nrow; i++) {
+            size_t k = row_ptr[i];
+            for_each_word(i, [&](uint64_t word, uint64_t mask) {
+                words[k]  = word;
+                bits[k++] = mask;
+            });
+        }
+    }
+
+    unsigned size() const override
+    {
+        return blocks.size();
+    }
+
+    float operator()(unsigned i, unsigned j) const override
+    {
+        if (evaluations) {
+            (*evaluations)[8 * omp_get_thread_num()]++;
+        }
+        size_t       a = row_ptr[i], b = row_ptr[j];
+        const size_t a_end = row_ptr[i + 1], b_end = row_ptr[j + 1];
+        uint64_t     shared = 0;
+        while (a < a_end && b < b_end) {
+            const uint64_t x = words[a];
+            const uint64_t y = words[b];
+            shared += std::popcount(x == y ? bits[a] & bits[b] : 0);
+            a += x <= y;
+            b += y <= x;
+        }
+        return float(blocks[i] + blocks[j] - 2 * shared);
+    }
+
+private:
+    HostVector<size_t>     row_ptr;
+    HostVector<uint64_t>   words;   // word index (block / 64) of each bitmap word
+    HostVector<uint64_t>   bits;    // blocks of the word that the row touches
+    HostVector<uint64_t>   blocks;  // blocks per row
+    std::vector<uint64_t>* evaluations;
+};
+
 
+// `values` (optional) receives the values of every row, for the value-aware metrics
 template<typename CSR>
-void convert_csr_to_adj(const CSR& mat, AdjVector<int>& adj)
+void convert_csr_to_adj(const CSR& mat, AdjVector<int>& adj, AdjVector<float>* values = nullptr)
 {
     adj.resize(mat.num_rows);
+    if (values) {
+        values->resize(mat.num_rows);
+    }
 
     thrust::host_vector<int> rowptr_h = mat.row_pointers;
 
@@ -82,16 +399,20 @@ void convert_csr_to_adj(const CSR& mat, AdjVector<int>& adj)
         adj[i].resize(row_length);
 
         thrust::copy(mat.column_indices.begin() + row_begin, mat.column_indices.begin() + row_end, adj[i].begin());
+        if (values) {
+            (*values)[i].resize(row_length);
+            thrust::copy(mat.values.begin() + row_begin, mat.values.begin() + row_end, (*values)[i].begin());
+        }
     }
 }
 
 template<typename Params>
-void set_index_params(Params& index_params, int K, int L)
+void set_index_params(Params& index_params, int K, int L, int iterations = 15)
 {
     index_params.K          = K;
     index_params.L          = L;
     index_params.reverse    = 0;
-    index_params.iterations = 15;
+    index_params.iterations = iterations;
     // index_params.S = 10;
     // index_params.R = 0.002;
     // index_params.controls = 0.7;
@@ -114,24 +435,81 @@ void set_search_params(Params& search_params, int K)
 }
 
 
-template<typename CSR1, typename CSR2>
-auto build_KNN_offline(const CSR1& mat, CSR2& knn)
+// Order every KNN row by (distance, neighbor id): get_nn() leaves equal distances in discovery order
+template<typename CSR>
+void sort_knn_rows(CSR& knn)
 {
-    const auto     nrow = mat.num_rows;
-    AdjVector<int> graph;
+    using IndexType = typename CSR::index_type;
+    using ValueType = typename CSR::value_type;
+
+#pragma omp parallel
+    {
+        std::vector<std::pair<ValueType, IndexType>> row;
+#pragma omp for schedule(static)
+        for (IndexType i = 0; i < knn.num_rows; i++) {
+            const auto begin = knn.row_pointers[i];
+            const auto end   = knn.row_pointers[i + 1];
+            row.clear();
+            for (auto j = begin; j < end; j++) {
+                row.emplace_back(knn.values[j], knn.column_indices[j]);
+            }
+            std::sort(row.begin(), row.end());
+            for (auto j = begin; j < end; j++) {
+                knn.values[j]         = row[j - begin].first;
+                knn.column_indices[j] = row[j - begin].second;
+            }
+        }
+    }
+}
+
+// Caps the OpenMP thread count for its lifetime and restores the previous one on exit, also when unwinding
+class OmpThreadLimit {
+public:
+    explicit OmpThreadLimit(int threads): saved(omp_get_max_threads())
+    {
+        omp_set_num_threads(threads);
+    }
+
+    ~OmpThreadLimit()
+    {
+        omp_set_num_threads(saved);
+    }
+
+    OmpThreadLimit(const OmpThreadLimit&)            = delete;
+    OmpThreadLimit& operator=(const OmpThreadLimit&) = delete;
 
-    convert_csr_to_adj(mat, graph);
-    AdjOracle<int> oracle(graph, sparse_hamming_distance);
+private:
+    int saved;
+};
+
+// NN-descent over any kgraph oracle; see build_KNN_from_adj
+template<typename CSR>
+void build_KNN_with_oracle(const kgraph::IndexOracle& oracle,
+                           CSR&                       knn,
+                           unsigned                   max_k,
+                           unsigned                   max_l,
+                           unsigned                   iterations,
+                           bool                       deterministic,
+                           unsigned                   seed)
+{
+    const auto nrow = oracle.size();
 
     kgraph::KGraph::IndexParams index_params;
     //! parameter tuning:
     //! https://github.com/Lsyhprum/WEAVESS/tree/dev/parameters
-    unsigned i_k = std::min<unsigned>(nrow - 1, 200);
-    unsigned i_l = std::min<unsigned>(i_k + 50, 300);
-    set_index_params(index_params, i_k, i_l);
+    unsigned i_k = std::min<unsigned>(nrow - 1, max_k);
+    unsigned i_l = std::min<unsigned>(i_k + 50, max_l);
+    set_index_params(index_params, i_k, i_l, iterations);
 
     kgraph::KGraph* index = kgraph::KGraph::create();
-    index->build(oracle, index_params);
+    {
+        std::optional<OmpThreadLimit> single_thread;
+        if (deterministic) {
+            index_params.seed = seed;
+            single_thread.emplace(1);
+        }
+        index->build(oracle, index_params);
+    }
 
     const unsigned nnz = nrow * i_k;
     ASSERT(nnz < std::numeric_limits<unsigned>::max());
@@ -140,10 +518,276 @@ auto build_KNN_offline(const CSR1& mat, CSR2& knn)
 
 #pragma omp parallel for
     for (unsigned i = 0; i < nrow; i++) {
-        auto row_begin = i * i_k;
-        index->get_nn(i, knn.column_indices.data() + row_begin, knn.values.data() + row_begin, &i_k, &i_l);
+        auto     row_begin = i * i_k;
+        unsigned k = i_k, l = i_l;  // get_nn writes back the sizes it used
+        index->get_nn(i, knn.column_indices.data() + row_begin, knn.values.data() + row_begin, &k, &l);
     }
     delete index;
+
+    if (deterministic) {
+        sort_knn_rows(knn);
+    }
+}
+
+// Call `fn` with the kgraph oracle of `metric` over the rows of `graph` (see build_KNN_from_adj)
+template<typename Fn>
+void with_knn_oracle(const AdjVector<int>&   graph,
+                     KnnMetric               metric,
+                     const AdjVector<float>* values,
+                     unsigned                block_cols,
+                     std::vector<uint64_t>*  evaluations,
+                     Fn&&                    fn)
+{
+    switch (metric) {
+        case KnnMetric::Jaccard:
+            fn(RowOracle<KnnMetric::Jaccard>(graph, values, evaluations));
+            break;
+        case KnnMetric::Overlap:
+            fn(RowOracle<KnnMetric::Overlap>(graph, values, evaluations));
+            break;
+        case KnnMetric::WeightedHamming:
+            fn(RowOracle<KnnMetric::WeightedHamming>(graph, values, evaluations));
+            break;
+        case KnnMetric::Cosine:
+            fn(RowOracle<KnnMetric::Cosine>(graph, values, evaluations));
+            break;
+        case KnnMetric::Blocks:
+            fn(BlockOracle(graph, block_cols, evaluations));
+            break;
+        default:
+            fn(RowOracle<KnnMetric::Hamming>(graph, values, evaluations));
+    }
+}
+
+// K = min(nrow - 1, max_k), L = min(K + 50, max_l); `graph` holds the rows (see convert_csr_to_adj),
+// `values` their values for the value-aware metrics, and `block_cols` is the block width of KnnMetric::Blocks.
+// With `deterministic`, NN-descent is seeded with `seed` and runs on one thread (its parallel joins merge
+// candidate lists in whatever order the threads arrive), and the rows are put in canonical order. The build
+// itself therefore takes up to thread-count times longer; reading the neighbors back and sorting them stay parallel.
+template<typename CSR>
+auto build_KNN_from_adj(const AdjVector<int>&   graph,
+                        CSR&                    knn,
+                        unsigned                max_k         = 200,
+                        unsigned                max_l         = 300,
+                        unsigned                iterations    = 15,
+                        bool                    deterministic = false,
+                        unsigned                seed          = 1984,
+                        KnnMetric               metric        = KnnMetric::Hamming,
+                        const AdjVector<float>* values        = nullptr,
+                        unsigned                block_cols    = 8)
+{
+    // distance evaluations are counted per thread (padded to a cache line) while tracing
+    const bool            tracing = Tracer::instance().enabled();
+    std::vector<uint64_t> evaluations(tracing ? 8 * omp_get_max_threads() : 0, 0);
+    std::vector<uint64_t>* counter = tracing ? &evaluations : nullptr;
+
+    with_knn_oracle(graph, metric, values, block_cols, counter, [&](const kgraph::IndexOracle& oracle) {
+        build_KNN_with_oracle(oracle, knn, max_k, max_l, iterations, deterministic, seed);
+    });
+    Tracer::instance().add_counter("distance_evaluations",
+                                   std::accumulate(evaluations.begin(), evaluations.end(), uint64_t(0)));
+}
+
+// `graph` is a reusable adjacency workspace
+template<typename CSR1, typename CSR2>
+auto build_KNN_offline(const CSR1&     mat,
+                       CSR2&           knn,
+                       AdjVector<int>& graph,
+                       unsigned        max_k         = 200,
+                       unsigned        max_l         = 300,
+                       unsigned        iterations    = 15,
+                       bool            deterministic = false,
+                       unsigned        seed          = 1984,
+                       KnnMetric       metric        = KnnMetric::Hamming,
+                       unsigned        block_cols    = 8)
+{
+    AdjVector<float> values;
+    convert_csr_to_adj(mat, graph, is_value_aware(metric) ? &values : nullptr);
+    build_KNN_from_adj(graph, knn, max_k, max_l, iterations, deterministic, seed, metric, &values, block_cols);
+}
+
+// Rough NN-descent cost model for time budgets: about L distance evaluations per row to initialize, and per
+// iteration a join of the sampled new and old neighbors of every row (S = 10 each by default), i.e. about
+// (2S)^2 / 2 evaluations per row. The margin covers the candidate sorting and locking around them.
+constexpr double knn_iteration_evaluations_per_row = 200;
+constexpr double knn_cost_margin                   = 2;
+
+// Average time of one distance of `oracle` (the metric the KNN graph is built with, see with_knn_oracle)
+// in ns, from random row pairs
+inline double sample_distance_ns(const kgraph::IndexOracle& oracle, unsigned samples = 1024, uint64_t seed = 1)
+{
+    const size_t nrow = oracle.size();
+    if (nrow < 2) {
+        return 0;
+    }
+    float    sink = 0;
+    CPUTimer timer;
+    timer.start();
+    for (unsigned s = 0; s < samples; s++) {
+        sink += oracle(random_below(seed, 0, s, nrow), random_below(seed, 1, s, nrow));
+    }
+    timer.stop();
+    volatile float keep = sink;  // keep the loop
+    (void)keep;
+    return timer.elapsed() * 1e6 / samples;
+}
+
+// NN-descent iterations (at most max_iterations) that the cost model fits into budget_ms; 0 if not even one
+inline unsigned plan_knn_iterations(const kgraph::IndexOracle& oracle,
+                                    unsigned                   max_k,
+                                    unsigned                   max_l,
+                                    unsigned                   max_iterations,
+                                    double                     budget_ms,
+                                    bool                       deterministic = false)
+{
+    const size_t nrow = oracle.size();
+    if (nrow < 2) {
+        return max_iterations;
+    }
+    const unsigned i_l     = std::min<unsigned>(std::min<unsigned>(nrow - 1, max_k) + 50, max_l);
+    const int      threads = deterministic ? 1 : omp_get_max_threads();
+    const double   eval_ms = sample_distance_ns(oracle) * 1e-6 * knn_cost_margin / threads;
+    const double   init_ms = eval_ms * nrow * i_l;
+    const double   step_ms = eval_ms * nrow * knn_iteration_evaluations_per_row;
+    if (init_ms + step_ms > budget_ms) {
+        return 0;
+    }
+    return std::min<double>(max_iterations, std::floor((budget_ms - init_ms) / step_ms));
+}
+
+// Cheap KNN for budgets too tight for NN-descent. The candidates of a row are the rows sharing a column with
+// it (at most max_scan rows per column), ranked by `metric` (Hamming, Jaccard and overlap from the shared
+// column counts, the others on the rows and their `values`); each row keeps up to K = min(nrow - 1, max_k).
+// Rows reached after the deadline get no neighbors, so they end up as singleton components. Returns the
+// number of rows the deadline cut off.
+template<typename CSR>
+size_t build_KNN_cooccurrence(const AdjVector<int>&   graph,
+                              size_t                  num_cols,
+                              CSR&                    knn,
+                              unsigned                max_k,
+                              const Deadline&         deadline,
+                              unsigned                max_scan   = 64,
+                              KnnMetric               metric     = KnnMetric::Hamming,
+                              const AdjVector<float>* values     = nullptr,
+                              unsigned                block_cols = 8)
+{
+    const size_t   nrow = graph.size();
+    const unsigned k    = nrow > 0 ? std::min<unsigned>(nrow - 1, max_k) : 0;
+    if (deadline.expired()) {
+        knn.resize(nrow, nrow, 0);
+        thrust::fill(knn.row_pointers.begin(), knn.row_pointers.end(), 0);
+        return nrow;
+    }
+
+    // column -> rows (serial, linear in the nonzeros: not interrupted)
+    HostVector<size_t> col_ptr(num_cols + 1);
+    std::fill(col_ptr.begin(), col_ptr.end(), 0);
+    for (size_t i = 0; i < nrow; i++) {
+        for (const auto c : graph[i]) {
+            col_ptr[c + 1]++;
+        }
+    }
+    std::partial_sum(col_ptr.begin(), col_ptr.end(), col_ptr.begin());
+    HostVector<unsigned> col_rows(col_ptr[num_cols]);
+    {
+        HostVector<size_t> fill(col_ptr.begin(), col_ptr.end() - 1);
+        for (size_t i = 0; i < nrow; i++) {
+            for (const auto c : graph[i]) {
+                col_rows[fill[c]++] = i;
+            }
+        }
+    }
+
+    auto distance = [&](size_t a, size_t b, float shared) {
+        const size_t na = graph[a].size(), nb = graph[b].size();
+        if (is_value_aware(metric)) {
+            return row_distance(
+                metric, graph[a].data(), (*values)[a].data(), na, graph[b].data(), (*values)[b].data(), nb);
+        }
+        if (metric == KnnMetric::Blocks) {
+            return block_distance(graph[a].data(), na, graph[b].data(), nb, block_cols);
+        }
+        RowOverlap overlap;
+        overlap.common = shared;
+        switch (metric) {
+            case KnnMetric::Jaccard:
+                return row_distance<KnnMetric::Jaccard>(na, nb, 0, 0, overlap);
+            case KnnMetric::Overlap:
+                return row_distance<KnnMetric::Overlap>(na, nb, 0, 0, overlap);
+            default:
+                return row_distance<KnnMetric::Hamming>(na, nb, 0, 0, overlap);
+        }
+    };
+
+    // rows are filled at a stride of K, then compacted
+    const size_t nnz = nrow * k;
+    ASSERT(nnz < std::numeric_limits<unsigned>::max());
+    knn.resize(nrow, nrow, nnz);
+    knn.row_pointers[0] = 0;
+
+    size_t skipped = 0;
+#pragma omp parallel
+    {
+        std::vector<unsigned>                   touched;
+        std::vector<std::pair<float, unsigned>> candidates;
+#pragma omp for schedule(dynamic, 64) reduction(+ : skipped)
+        for (int64_t i = 0; i < int64_t(nrow); i++) {
+            unsigned* ids           = knn.column_indices.data() + i * k;
+            float*    ds            = knn.values.data() + i * k;
+            knn.row_pointers[i + 1] = 0;
+            if (deadline.expired()) {
+                skipped++;
+                continue;
+            }
+
+            touched.clear();
+            for (const auto c : graph[i]) {
+                const size_t begin = col_ptr[c];
+                const size_t end   = std::min<size_t>(col_ptr[c + 1], begin + max_scan);
+                for (size_t j = begin; j < end; j++) {
+                    if (col_rows[j] != unsigned(i)) {
+                        touched.push_back(col_rows[j]);
+                    }
+                }
+            }
+            // runs of equal rows count the shared columns
+            std::sort(touched.begin(), touched.end());
+            candidates.clear();
+            for (size_t j = 0; j < touched.size();) {
+                size_t run = j;
+                while (run < touched.size() && touched[run] == touched[j]) {
+                    run++;
+                }
+                const float shared = run - j;
+                candidates.emplace_back(distance(i, touched[j], shared), touched[j]);
+                j = run;
+            }
+            const size_t count = std::min<size_t>(k, candidates.size());
+            std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+            for (size_t j = 0; j < count; j++) {
+                ids[j] = candidates[j].second;
+                ds[j]  = candidates[j].first;
+            }
+            knn.row_pointers[i + 1] = count;
+        }
+    }
+
+    for (size_t i = 0; i < nrow; i++) {
+        const size_t count      = knn.row_pointers[i + 1];
+        const size_t begin      = knn.row_pointers[i];
+        knn.row_pointers[i + 1] = begin + count;
+        std::copy_n(knn.column_indices.begin() + i * k, count, knn.column_indices.begin() + begin);
+        std::copy_n(knn.values.begin() + i * k, count, knn.values.begin() + begin);
+    }
+    knn.resize(nrow, nrow, knn.row_pointers[nrow]);
+    return skipped;
+}
+
+template<typename CSR1, typename CSR2>
+auto build_KNN_offline(const CSR1& mat, CSR2& knn)
+{
+    AdjVector<int> graph;
+    build_KNN_offline(mat, knn, graph);
 }
 
 template<typename CSR, typename COO>
@@ -152,14 +796,10 @@ void clean_graph(const CSR& csr, COO& coo)
     using IndexType = typename CSR::index_type;
     using ValueType = typename CSR::value_type;
 
-    thrust::host_vector<IndexType> row_indices(csr.num_entries);
-
-    // uA.num_rows = A.num_rows;
-    // uA.num_cols = A.num_cols;
-    // uA.num_entries= A.num_entries;
-    thrust::host_vector<ValueType> values_h         = csr.values;
-    thrust::host_vector<IndexType> row_pointers_h   = csr.row_pointers;
-    thrust::host_vector<IndexType> column_indices_h = csr.column_indices;
+    // sort temporaries come from the scratch arena
+    ArenaScope            scratch(scratch_arena());
+    arena_allocator<char> alloc(scratch_arena());
+    const auto            policy = get_exec_policy<typename COO::IndexVector>(alloc);
 
     coo.resize(csr.num_rows, csr.num_cols, csr.num_entries);
     coo.column_indices = csr.column_indices;
@@ -170,12 +810,14 @@ void clean_graph(const CSR& csr, COO& coo)
         thrust::make_zip_iterator(thrust::make_tuple(coo.row_indices.begin(), coo.column_indices.begin()));
 
     // Sort by (row, col)
-    sort_columns_per_row(coo.row_indices, coo.column_indices, coo.values);
+    sort_columns_per_row(policy, coo.row_indices, coo.column_indices, coo.values);
 
     // print_zeros(coo, "after sort");
     //  Remove duplicates
-    auto unique_end  = thrust::unique_by_key(row_col_begin, row_col_begin + coo.num_entries, coo.values.begin());
+    auto unique_end =
+        thrust::unique_by_key(policy, row_col_begin, row_col_begin + coo.num_entries, coo.values.begin());
     auto unique_size = thrust::distance(row_col_begin, unique_end.first);
+    Tracer::instance().add_counter("edges_in", coo.num_entries);
     coo.resize(coo.num_rows, coo.num_cols, unique_size);
 
     // print_zeros(coo, "after unique");
@@ -186,14 +828,16 @@ void clean_graph(const CSR& csr, COO& coo)
         thrust::make_tuple(coo.row_indices.end(), coo.column_indices.end(), coo.values.end()));
 
     // Resize the matrix
-    auto new_end  = thrust::remove_if(row_col_val_begin, row_col_val_end, IsSelfLoop<IndexType, ValueType>());
+    auto new_end  = thrust::remove_if(policy, row_col_val_begin, row_col_val_end, IsSelfLoop<IndexType, ValueType>());
     int  new_size = thrust::distance(row_col_val_begin, new_end);
     coo.resize(coo.num_rows, coo.num_cols, new_size);
+    Tracer::instance().add_counter("edges_out", new_size);
 
-    printf("unique size %d, new size %d\n", unique_size, new_size);
     // print_zeros(coo, "after self-loop");
-    // Sort by values
-    thrust::sort_by_key(
+    // Sort by values; the edges are still in (row, col) order, so a stable sort gives the total order
+    // (weight, u, v) and Kruskal does not depend on how the sort splits ties
+    thrust::stable_sort_by_key(
+        policy,
         coo.values.begin(),
         coo.values.end(),
         thrust::make_zip_iterator(thrust::make_tuple(coo.row_indices.begin(), coo.column_indices.begin())));
@@ -204,8 +848,16 @@ void clean_graph(const CSR& csr, COO& coo)
 // TODO: parallel MST - https://github.com/abarankab/parallel-boruvka
 //? Reference:
 // https://www.geeksforgeeks.org/kruskals-minimum-spanning-tree-using-stl-in-c/
-template<typename COO, typename Tree, typename Vector>
-auto build_MST(const COO& coo, Tree& tree, Vector& roots)
+// Kruskal over the weight-sorted edges of clean_graph. Once `deadline` expires the remaining edges are
+// skipped (*truncated is set), leaving a spanning forest of the edges examined so far. `tree_edges` receives
+// the index in `coo` of every tree edge, in the order they were added (see replay_MST).
+template<typename COO, typename Tree, typename Vector, typename EdgeVector = thrust::host_vector<size_t>>
+auto build_MST(const COO&      coo,
+               Tree&           tree,
+               Vector&         roots,
+               const Deadline& deadline   = Deadline(),
+               bool*           truncated  = nullptr,
+               EdgeVector*     tree_edges = nullptr)
 {
     using T = typename Vector::value_type;
     using F = typename COO::value_type;
@@ -214,14 +866,18 @@ auto build_MST(const COO& coo, Tree& tree, Vector& roots)
     const auto nrow        = coo.num_rows;
     const auto nnz         = coo.num_entries;
 
-    thrust::host_vector<T> parents(nrow);
-    thrust::host_vector<T> ranks(nrow);
+    ArenaScope     scratch(scratch_arena());
+    ArenaVector<T> parents(nrow, scratch_arena());
+    ArenaVector<T> ranks(nrow, T(0), scratch_arena());
 
     thrust::sequence(parents.begin(), parents.end(), 0);
+    uint64_t find_calls = 0, find_steps = 0;
     // find
-    auto find = [&parents](int i) {
+    auto find = [&parents, &find_calls, &find_steps](int i) {
+        find_calls++;
         while (parents[i] != i) {
             i = parents[i];
+            find_steps++;
         }
         return i;
     };
@@ -247,8 +903,13 @@ auto build_MST(const COO& coo, Tree& tree, Vector& roots)
 
     // O(ElogV)  parents[source] = root
     // tree.adjs[source] = parents[source];
-    for (T i = 0; i < nnz; i++) {
-        auto source = coo.row_indices[i];
+    T examined = 0;
+    for (; examined < nnz; examined++) {
+        if (examined % 4096 == 0 && deadline.expired()) {
+            break;
+        }
+        const auto i      = examined;
+        auto       source = coo.row_indices[i];
         auto target = coo.column_indices[i];
         auto weight = coo.values[i];
 
@@ -257,18 +918,19 @@ auto build_MST(const COO& coo, Tree& tree, Vector& roots)
             unite_rank(source, target);
             tree.adjs[source].push_back(target);
             tree.adjs[target].push_back(source);
+            if (tree_edges) {
+                tree_edges->push_back(i);
+            }
         }
     }
     tree.num_nodes = nrow;
-
-    // verify for MST: num_edges = num_nodes - 1
-    {
-        auto num_edges = 0;
-        for (const auto& [node, adjs] : tree.adjs) {
-            num_edges += adjs.size();
-        }
-        printf("total edges in tree: %d, expected edges: %d\n", num_edges, 2 * tree.num_nodes - 2);
+    if (truncated) {
+        *truncated = examined < nnz;
     }
+    Tracer::instance().add_counter("edges_examined", examined);
+    Tracer::instance().add_counter("union_find_ops", find_calls);
+    Tracer::instance().add_counter("union_find_steps", find_steps);
+
     // print_vec(parents, "parents ", 16);
     // print_vec(ranks, "ranks ", 16);
     // Collect root nodes (nodes where parents[i] == i)
@@ -276,21 +938,41 @@ auto build_MST(const COO& coo, Tree& tree, Vector& roots)
                  thrust::counting_iterator<T>(nrow),
                  std::back_inserter(roots),
                  [parents_ptr = parents.data()](T i) { return i == parents_ptr[i]; });
-    printf("roots.size() = %d\n", roots.size());
 
     return MST_weights;
 }
 
+// Rebuild the forest of build_MST from its tree edges (same adjacency order, same total weight).
+// The edges must index `coo` (ReorderCache::load_forest checks checkpoints against it).
+template<typename COO, typename Tree, typename EdgeVector>
+auto replay_MST(const COO& coo, const EdgeVector& tree_edges, Tree& tree)
+{
+    typename COO::value_type MST_weights = 0.0;
+    for (const auto i : tree_edges) {
+        ASSERT(size_t(i) < size_t(coo.num_entries));
+        const auto source = coo.row_indices[i];
+        const auto target = coo.column_indices[i];
+        MST_weights += coo.values[i];
+        tree.adjs[source].push_back(target);
+        tree.adjs[target].push_back(source);
+    }
+    tree.num_nodes = coo.num_rows;
+    return MST_weights;
+}
+
 template<typename Tree, typename Vector>
 auto perform_DFS(const Tree& tree, const Vector& roots, Vector& new_ids)
 {
     using T = typename Vector::value_type;
 
-    const auto                  num_nodes = tree.num_nodes;
-    T                           max_depth = 0;
-    std::stack<std::pair<T, T>> node_stack;  // (node, depth)
-    std::vector<bool>           visited(num_nodes, false);
-    std::vector<T>              ordered_nodes;
+    using Entry = std::pair<T, T>;  // (node, depth)
+
+    ArenaScope                            scratch(scratch_arena());
+    const auto                            num_nodes = tree.num_nodes;
+    T                                     max_depth = 0;
+    std::stack<Entry, ArenaVector<Entry>> node_stack{ArenaVector<Entry>(scratch_arena())};
+    ArenaVector<bool>                     visited(num_nodes, false, scratch_arena());
+    ArenaVector<T>                        ordered_nodes(scratch_arena());
 
     ordered_nodes.reserve(num_nodes);
 
@@ -342,53 +1024,4 @@ auto perform_DFS(const Tree& tree, const Vector& roots, Vector& new_ids)
 }
 
 
-template<typename CSR, typename Vector>
-auto groot(const CSR& mat, Vector& new_ids)
-{
-    CPUTimer timer;
-    //+++++++++
-    //++ KNN ++
-    //+++++++++
-    std::cout << "Step 1: KNN" << std::endl;
-    // Kgraph requires unsigned index type
-    CsrMatrix<unsigned, float, host_memory> knn;
-
-    timer.start();
-
-    build_KNN_offline(mat, knn);  // reverse edges -> undirected
-    timer.stop();
-    printf("[kGraph] time (ms): %f \n", timer.elapsed());
-
-    ASSERT(knn.num_entries == knn.row_pointers.back() && knn.num_entries == knn.column_indices.size());
-
-    //+++++++++
-    //++ MST ++
-    //+++++++++
-    std::cout << "Step 2: MST" << std::endl;
-    //? csr -> coo
-    CooMatrix<unsigned, float, host_memory> uknn;
-    clean_graph(knn, uknn);  // prepare for MST
-
-    //? csr -> coo
-    Tree<unsigned>           tree;
-    thrust::host_vector<int> roots;
-    timer.start();
-    auto weights = build_MST(uknn, tree, roots);
-    timer.stop();
-    printf("[MST] time (ms): %f \n", timer.elapsed());
-    printf("total weights of MST: %.2f\n", weights);
-
-    //++++++++++++
-    //++ DFS ++
-    //++++++++++++
-    std::cout << "Step 3: DFS" << std::endl;
-    timer.start();
-    auto depth = perform_DFS(tree, roots, new_ids);
-    timer.stop();
-    printf("[DFS] time (ms): %f \n", timer.elapsed());
-    ASSERT(new_ids.size() == mat.num_rows);
-
-    printf("Max Depth: %d\n", depth);
-}
-
 }  // namespace groot
@@ -3,56 +3,85 @@
 
 #include <omp.h>
 
+#include <algorithm>
+#include <type_traits>
+
 namespace groot {
 
+// Distance (in nonzeros) of the software prefetch for the gather through new_id[colidx[j]]
+constexpr int rebuild_prefetch_distance = 16;
+
+// Rebuild a host CSR with rows moved to new_id[i] and columns relabeled (rows are not re-sorted).
+// Columns are only relabeled for square matrices with `permute_columns`; otherwise rows keep their columns
+// (and stay sorted). Nonzeros are split evenly across threads (a hub row may be shared by several threads),
+// and the rebuilt arrays are swapped in, so only one extra copy of column indices and values is alive at peak.
 template<typename CsrMatrix, typename Vector>
-void build_csr_cpu(CsrMatrix& mat, const Vector& new_id)
+void build_csr_cpu(CsrMatrix& mat, const Vector& new_id, bool permute_columns = true)
 {
     using IndexType = typename CsrMatrix::index_type;
     using ValueType = typename CsrMatrix::value_type;
+    static_assert(std::is_same_v<typename CsrMatrix::memory_space, host_memory>, "build_csr_cpu needs a host matrix");
     ASSERT(mat.num_rows == new_id.size());
 
-    thrust::host_vector<IndexType> rowptr = mat.row_pointers;
-    thrust::host_vector<IndexType> colidx = mat.column_indices;
-    thrust::host_vector<ValueType> values = mat.values;
+    const IndexType* rowptr = mat.row_pointers.data();
+    const IndexType* colidx = mat.column_indices.data();
+    const ValueType* values = mat.values.data();
+    const auto*      newid  = new_id.data();
+    const IndexType  nrow   = mat.num_rows;
+    const IndexType  nnz    = mat.num_entries;
+    const bool       relabel = permute_columns && mat.num_rows == mat.num_cols;
 
-    IndexType max_threads = omp_get_max_threads();
+    // Assign the outdegree to new id, then scan into the new row pointers
+    HostVector<IndexType> new_row(nrow + 1);
+    new_row[0] = 0;
+#pragma omp parallel for schedule(static)
+    for (IndexType i = 0; i < nrow; i++)
+        new_row[newid[i] + 1] = rowptr[i + 1] - rowptr[i];
+    thrust::inclusive_scan(thrust::host, new_row.begin(), new_row.end(), new_row.begin());
 
-    thrust::host_vector<IndexType> new_degree(mat.num_rows, 0);
-// Assign the outdegree to new id
-#pragma omp parallel for schedule(static) num_threads(max_threads)
-    for (IndexType i = 0; i < mat.num_rows; i++)
-        new_degree[new_id[i]] = rowptr[i + 1] - rowptr[i];
+    HostVector<IndexType> new_col(nnz);
+    HostVector<ValueType> new_val(nnz);
 
-    // Build new row_index array
-    thrust::host_vector<IndexType> new_row(mat.num_rows + 1, 0);
-    thrust::host_vector<IndexType> new_col(mat.num_entries, 0);
-    thrust::host_vector<ValueType> new_val(mat.num_entries, 0);
+    // Build new col_index array: thread t owns nonzeros [t * nnz / T, (t + 1) * nnz / T)
+#pragma omp parallel
+    {
+        const int     num_threads = omp_get_num_threads();
+        const int     tid         = omp_get_thread_num();
+        const int64_t begin       = int64_t(nnz) * tid / num_threads;
+        const int64_t end         = int64_t(nnz) * (tid + 1) / num_threads;
 
-    thrust::inclusive_scan(new_degree.begin(), new_degree.end(), new_row.begin() + 1);
+        // row holding nonzero `begin`: rowptr[i] <= begin < rowptr[i + 1]
+        IndexType i       = std::upper_bound(rowptr, rowptr + nrow + 1, IndexType(begin)) - rowptr - 1;
+        int64_t   row_end = begin < end ? rowptr[i + 1] : end;
+        IndexType shift   = begin < end ? new_row[newid[i]] - rowptr[i] : 0;
 
-    // Build new col_index array
-#pragma omp parallel for schedule(static, 256) num_threads(max_threads)
-    for (IndexType i = 0; i < mat.num_rows; i++) {
-        IndexType count = 0;
-        for (IndexType j = rowptr[i]; j < rowptr[i + 1]; j++) {
-            new_col[new_row[new_id[i]] + count] = new_id[colidx[j]];
-            new_val[new_row[new_id[i]] + count] = values[j];
-            count++;
+        for (int64_t j = begin; j < end; j++) {
+            while (j >= row_end) {
+                i++;
+                row_end = rowptr[i + 1];
+                shift   = new_row[newid[i]] - rowptr[i];
+            }
+            if (relabel && j + rebuild_prefetch_distance < end) {
+                __builtin_prefetch(&newid[colidx[j + rebuild_prefetch_distance]]);
+            }
+            new_col[j + shift] = relabel ? IndexType(newid[colidx[j]]) : colidx[j];
+            new_val[j + shift] = values[j];
         }
     }
-    thrust::copy(new_row.begin(), new_row.end(), mat.row_pointers.begin());
-    thrust::copy(new_col.begin(), new_col.end(), mat.column_indices.begin());
-    thrust::copy(new_val.begin(), new_val.end(), mat.values.begin());
 
+    mat.row_pointers.swap(new_row);
+    mat.column_indices.swap(new_col);
+    mat.values.swap(new_val);
 }
 
+// Device version of build_csr_cpu (same column rule)
 template<typename CsrMatrix, typename Vector>
-void build_csr_gpu(CsrMatrix& mat, const Vector& new_id)
+void build_csr_gpu(CsrMatrix& mat, const Vector& new_id, bool permute_columns = true)
 {
     using IndexType = typename CsrMatrix::index_type;
     using ValueType = typename CsrMatrix::value_type;
     ASSERT(mat.num_rows == new_id.size());
+    const bool relabel = permute_columns && mat.num_rows == mat.num_cols;
 
     thrust::device_vector<IndexType> new_degree(mat.num_rows, 0);
 
@@ -85,11 +114,12 @@ void build_csr_gpu(CsrMatrix& mat, const Vector& new_id)
                       new_row = thrust::raw_pointer_cast(new_row.data()),
                       new_col = thrust::raw_pointer_cast(new_col.data()),
                       new_val = thrust::raw_pointer_cast(new_val.data()),
-                      new_id  = thrust::raw_pointer_cast(new_id.data())] __device__(IndexType i) {
+                      new_id  = thrust::raw_pointer_cast(new_id.data()),
+                      relabel] __device__(IndexType i) {
                          IndexType count     = 0;
                          IndexType new_start = new_row[new_id[i]];
                          for (IndexType j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
-                             new_col[new_start + count] = new_id[col_idx[j]];
+                             new_col[new_start + count] = relabel ? new_id[col_idx[j]] : col_idx[j];
                              new_val[new_start + count] = values[j];
                              count++;
                          }
@@ -101,6 +131,127 @@ void build_csr_gpu(CsrMatrix& mat, const Vector& new_id)
     mat.values         = std::move(new_val);
 }
 
+// Parallel counting-sort transpose with relabeling: entry (i, j) of src becomes entry (row_map[j], i) of dst.
+// Source rows are scanned in order, so every dst row comes out sorted by column. Work is split into
+// nnz-balanced row ranges, each with its own histogram over dst rows; the number of ranges is capped so
+// the histograms stay in the order of nnz. The histograms live in the scratch arena.
+template<typename SrcIndexVector,
+         typename SrcValueVector,
+         typename Vector,
+         typename DstIndexVector,
+         typename DstValueVector>
+void transpose_with_map(const SrcIndexVector& src_ptr,
+                        const SrcIndexVector& src_col,
+                        const SrcValueVector& src_val,
+                        const Vector&         row_map,
+                        DstIndexVector&       dst_ptr,
+                        DstIndexVector&       dst_col,
+                        DstValueVector&       dst_val)
+{
+    using IndexType = typename SrcIndexVector::value_type;
+    static_assert(std::is_same_v<IndexType, typename DstIndexVector::value_type>);
+
+    const IndexType src_rows = src_ptr.size() - 1;
+    const IndexType dst_rows = row_map.size();
+    const IndexType nnz      = src_ptr[src_rows];
+
+    const int64_t entries_per_row = std::max<int64_t>(1, int64_t(nnz) / std::max<int64_t>(dst_rows, 1));
+    const int     num_parts       = std::clamp<int64_t>(4 * entries_per_row, 1, omp_get_max_threads());
+    const auto    bounds          = partition_rows_by_nnz(src_ptr.data(), src_rows, num_parts);
+
+    // the outputs may be arena vectors of the caller: carve them out before the scope below, which
+    // hands everything drawn inside it back to the arena on return
+    dst_ptr.resize(dst_rows + 1);
+    dst_col.resize(nnz);
+    dst_val.resize(nnz);
+
+    // one histogram per part, zeroed by the thread that fills it
+    ArenaScope             scratch(scratch_arena());
+    ArenaVector<IndexType> counts(size_t(num_parts) * dst_rows, scratch_arena());
+#pragma omp parallel for schedule(static, 1)
+    for (int p = 0; p < num_parts; p++) {
+        IndexType* count = counts.data() + size_t(p) * dst_rows;
+        std::fill_n(count, dst_rows, IndexType(0));
+        for (IndexType j = src_ptr[bounds[p]]; j < src_ptr[bounds[p + 1]]; j++) {
+            count[row_map[src_col[j]]]++;
+        }
+    }
+
+#pragma omp parallel for schedule(static)
+    for (IndexType r = 0; r < dst_rows; r++) {
+        IndexType running = 0;
+        for (int p = 0; p < num_parts; p++) {
+            const IndexType tmp              = counts[size_t(p) * dst_rows + r];
+            counts[size_t(p) * dst_rows + r] = running;
+            running += tmp;
+        }
+        dst_ptr[r] = running;
+    }
+    dst_ptr[dst_rows] = 0;
+    thrust::exclusive_scan(thrust::host, dst_ptr.begin(), dst_ptr.end(), dst_ptr.begin());
+
+#pragma omp parallel for schedule(static, 1)
+    for (int p = 0; p < num_parts; p++) {
+        IndexType* cursor = counts.data() + size_t(p) * dst_rows;
+        for (IndexType i = bounds[p]; i < bounds[p + 1]; i++) {
+            for (IndexType j = src_ptr[i]; j < src_ptr[i + 1]; j++) {
+                const IndexType r   = row_map[src_col[j]];
+                const IndexType dst = dst_ptr[r] + cursor[r]++;
+                dst_col[dst]        = i;
+                dst_val[dst]        = src_val[j];
+            }
+        }
+    }
+}
+
+// Apply a symmetric permutation (P A P^T) to a host CSR in linear time.
+// The first transpose moves column j to row new_id[j], the second moves row i to row new_id[i] and emits
+// the columns in increasing order, so no comparison sort is needed. Duplicates end up adjacent and are
+// dropped in a final linear pass. The second transpose writes into the matrix arrays, so only one extra
+// copy of the matrix is alive at a time; that copy is taken from the scratch arena.
+// Rectangular matrices, or `permute_columns` = false, get the row permutation only (P A): rows are moved
+// by build_csr_cpu and keep their columns as they are.
+template<typename CsrMatrix, typename Vector>
+void permute_csr_cpu(CsrMatrix& mat, const Vector& new_id, bool permute_columns = true)
+{
+    using IndexType = typename CsrMatrix::index_type;
+    using ValueType = typename CsrMatrix::value_type;
+    ASSERT(mat.num_rows == new_id.size());
+    if (!permute_columns || mat.num_rows != mat.num_cols) {
+        build_csr_cpu(mat, new_id, false);
+        return;
+    }
+
+    ArenaScope             scratch(scratch_arena());
+    ArenaVector<IndexType> t_ptr(scratch_arena());
+    ArenaVector<IndexType> t_col(scratch_arena());
+    ArenaVector<ValueType> t_val(scratch_arena());
+
+    transpose_with_map(mat.row_pointers, mat.column_indices, mat.values, new_id, t_ptr, t_col, t_val);
+    transpose_with_map(t_ptr, t_col, t_val, new_id, mat.row_pointers, mat.column_indices, mat.values);
+
+    segmented_sort_rows(mat.row_pointers, mat.column_indices, &mat.values, true);
+    mat.num_entries = mat.row_pointers[mat.num_rows];
+}
+
+template<typename Config>
+ReorderOptions get_reorder_options(const Config& config)
+{
+    ReorderOptions options;
+    options.knn_k          = config.knn_k;
+    options.knn_l          = config.knn_l;
+    options.knn_metric     = config.knn_metric;
+    options.knn_block_cols = config.tile_cols;
+    options.cache_dir      = config.cache_dir;
+    options.checkpoints    = config.checkpoints;
+    options.deterministic  = config.deterministic;
+    options.seed           = config.seed;
+
+    options.time_budget_ms = config.time_budget_ms;
+    options.fallback       = config.original_fallback ? BudgetFallback::Original : BudgetFallback::Degree;
+    return options;
+}
+
 template<typename Config, typename CsrMatrix>
 void reorder_graph(Config config, CsrMatrix& mat)
 {
@@ -109,25 +260,105 @@ void reorder_graph(Config config, CsrMatrix& mat)
     }
 
     printf("\n\n----------------Reordering Graph----------------\n");
-    thrust::device_vector<int> new_ids(mat.num_rows);
+
+    // `blocks` groups rows by blocks of the input column order, which a symmetric rebuild relabels
+    if (config.knn_metric == KnnMetric::Blocks && mat.num_rows == mat.num_cols
+        && config.column_permutation_file.empty()) {
+        printf("warning: the symmetric rebuild relabels the columns the blocks metric grouped rows by; "
+               "use -q to keep them or another -M metric\n");
+    }
 
     // TODO: implement the knn_mst_dfs on GPU
     thrust::host_vector<int> new_ids_h(mat.num_rows);
-    CPUTimer                 cpu_timer;
-    cpu_timer.start();
-    groot(mat, new_ids_h);  // on CPU
-    cpu_timer.stop();
-    printf("[KNN_MST_DFS] Reordering time (ms): %f \n", cpu_timer.elapsed());
-    thrust::copy(new_ids_h.begin(), new_ids_h.end(), new_ids.begin());
-
-    CUDATimer timer;
-    timer.start();
-    build_csr_gpu(mat, new_ids);
-    timer.stop();
-    printf("[Rebuilding] graph time (ms): %f \n", timer.elapsed());
-
-    // organize and prune the graph
-    sort_columns_per_row(mat);
+    CPUTimer                 reorder_timer;
+    reorder_timer.start();
+    if (!config.incremental_dir.empty()) {
+        reorder_incremental(get_reorder_options(config), config.incremental_dir, mat, new_ids_h);
+    }
+    else {
+        Reorderer  reorderer(get_reorder_options(config));
+        const auto stats = reorderer.compute(mat, new_ids_h);  // on CPU
+        print_reorder_stats(stats);
+        printf("[KNN_MST_DFS] Reordering time (ms): %f \n", stats.total_ms);
+    }
+    reorder_timer.stop();
+
+    // two-sided: a second Groot pass orders the columns by the row panels they share
+    const TileShape          shape{config.tile_rows, config.tile_cols};
+    const bool               two_sided = !config.column_permutation_file.empty();
+    thrust::host_vector<int> col_ids_h;
+    if (two_sided) {
+        printf("\n----------------Reordering Columns----------------\n");
+        // the column pass gets what the row pass left of the time budget (a sliver: the fallback order)
+        ReorderOptions column_options = get_reorder_options(config);
+        if (column_options.time_budget_ms > 0) {
+            column_options.time_budget_ms = std::max(column_options.time_budget_ms - reorder_timer.elapsed(), 1e-3);
+        }
+        const auto stats = order_columns(column_options, mat, new_ids_h, shape, col_ids_h);
+        print_reorder_stats(stats);
+        printf("[KNN_MST_DFS] Column reordering time (ms): %f \n", stats.total_ms);
+        if (!write_permutation_file(col_ids_h, config.column_permutation_file)) {
+            std::exit(1);
+        }
+    }
+    print_tile_report(mat, new_ids_h, two_sided ? &col_ids_h : nullptr, shape);
+
+    if (!config.permutation_file.empty()) {
+        if (!write_permutation_file(new_ids_h, config.permutation_file)) {
+            std::exit(1);
+        }
+        // consumers apply the permutation themselves (e.g. through PermutedCsrView)
+        if (config.output_file.empty()) {
+            return;
+        }
+    }
+
+    TraceScope rebuild_scope("rebuild");
+    PerfPhase  rebuild_perf;
+    CPUTimer   cpu_timer;
+    rebuild_scope.counter("nnz_in", mat.num_entries);
+
+    // rectangular matrices have no matching column permutation: unless ordered separately, their columns stay
+    const bool symmetric = mat.num_rows == mat.num_cols;
+    printf("[Rebuilding] %s permutation (%d x %d)\n",
+           two_sided ? "two-sided" : symmetric ? "symmetric" : "row-only",
+           int(mat.num_rows),
+           int(mat.num_cols));
+
+    if constexpr (std::is_same_v<typename CsrMatrix::memory_space, host_memory>) {
+        // rows come out sorted: no sort_columns_per_row needed
+        cpu_timer.start();
+        if (two_sided) {
+            build_csr_cpu(mat, new_ids_h, false);
+            permute_columns_cpu(mat, col_ids_h);
+        }
+        else {
+            permute_csr_cpu(mat, new_ids_h);
+        }
+        cpu_timer.stop();
+        printf("[Rebuilding] graph time (ms): %f \n", cpu_timer.elapsed());
+    }
+    else {
+        thrust::device_vector<int> new_ids = new_ids_h;
+
+        TimerType<typename CsrMatrix::memory_space> timer;
+        timer.start();
+        build_csr_gpu(mat, new_ids, !two_sided);
+        if (two_sided) {
+            thrust::device_vector<int> col_ids = col_ids_h;
+            thrust::device_vector<int> columns(mat.num_entries);
+            thrust::gather(mat.column_indices.begin(), mat.column_indices.end(), col_ids.begin(), columns.begin());
+            mat.column_indices.swap(columns);
+        }
+        timer.stop();
+        printf("[Rebuilding] graph time (ms): %f \n", timer.elapsed());
+
+        // organize and prune the graph
+        sort_columns_per_row(mat);
+    }
+    rebuild_scope.counter("nnz_out", mat.num_entries);
+    print_perf_sample("Rebuilding", rebuild_perf.sample());
+    print_arena_stats(scratch_arena().stats());
 }
 
 }  // namespace groot
\ No newline at end of file
@@ -0,0 +1,423 @@
+#pragma once
+
+namespace groot {
+
+// Order of whatever a time budget cut off: decreasing row length (stable), or the original order
+enum class BudgetFallback { Degree = 0, Original };
+
+struct ReorderOptions {
+    unsigned knn_k          = 200;  // neighbors per row, K = min(nrow - 1, knn_k)
+    unsigned knn_l          = 300;  // kgraph pool size cap, L = min(K + 50, knn_l)
+    unsigned knn_iterations = 15;   // kgraph NN-descent iterations
+
+    KnnMetric knn_metric     = KnnMetric::Hamming;  // row distance of the KNN graph (see knn.h)
+    unsigned  knn_block_cols = 8;                   // column block width of KnnMetric::Blocks (one tile column)
+
+    // same permutation for the same input and seed, whatever the thread count and timing
+    // (the KNN build then runs on one thread; all other phases are deterministic anyway). The time budget
+    // depends on timing, so it is ignored in this mode
+    bool     deterministic = false;
+    unsigned seed          = 1984;
+
+    std::string cache_dir;            // reuse KNN graphs and permutations from this directory (empty: no cache)
+    bool        checkpoints = false;  // also keep the clean edges and the MST forest there, to resume from
+
+    // wall-clock budget of compute() (0: none). KNN gets cheaper (fewer NN-descent iterations, or the
+    // co-occurrence KNN), MST stops early, and the components it did not bridge are ordered by `fallback`.
+    // The budget is checked between phases, per row of the co-occurrence KNN and every 4096 MST edges; the
+    // input conversion, the NN-descent iterations (sized by a cost estimate) and clean_graph run to the end,
+    // so a run can overshoot by as much as one of them takes. Ignored when `deterministic` is set
+    double         time_budget_ms = 0;
+    BudgetFallback fallback       = BudgetFallback::Degree;
+};
+
+// Share of the remaining budget the KNN step may use; clean, MST and DFS get the rest
+constexpr double knn_budget_share = 0.7;
+
+// Bump when a change alters the KNN graph or the permutation computed for the same parameters
+constexpr uint64_t reorder_cache_version = 2;
+
+struct ReorderStats {
+    double knn_ms   = 0;
+    double clean_ms = 0;
+    double mst_ms   = 0;
+    double dfs_ms   = 0;
+    double total_ms = 0;
+
+    size_t knn_edges  = 0;  // KNN edges handed to the MST (after deduplication and self-loop removal)
+    size_t tree_edges = 0;  // edges of the spanning forest
+    size_t num_roots  = 0;  // connected components of the forest
+    double mst_weight = 0;
+    int    max_depth  = 0;  // deepest DFS level
+
+    bool knn_cached         = false;  // KNN graph loaded from the cache
+    bool edges_cached       = false;  // resumed from the clean checkpoint: KNN and clean skipped
+    bool mst_cached         = false;  // resumed from the MST checkpoint: the forest is replayed
+    bool permutation_cached = false;  // whole pipeline skipped
+
+    // hardware counters per phase (empty unless PerfCounters::instance().enable() was called)
+    PerfSample knn_perf;
+    PerfSample clean_perf;
+    PerfSample mst_perf;
+    PerfSample dfs_perf;
+
+    // scratch arena of the calling thread (core/arena.h)
+    size_t scratch_allocated = 0;  // bytes drawn by this call
+    size_t scratch_reused    = 0;  // of those, bytes on pages an earlier phase or call already used
+
+    // time budget: what was cut short
+    unsigned knn_iterations   = 0;      // NN-descent iterations run
+    bool     knn_cooccurrence = false;  // not even one iteration fitted: co-occurrence KNN instead
+    size_t   knn_rows_skipped = 0;      // rows the co-occurrence KNN did not reach (singleton components)
+    bool     knn_truncated    = false;  // fewer iterations than requested, or the co-occurrence KNN
+    bool     mst_truncated    = false;  // DFS visits the components left unbridged in fallback order
+    bool     fallback_order   = false;  // no time left for clean and MST: the permutation is the fallback order
+};
+
+// rows[position] = row in `fallback` order
+template<typename CSR, typename Vector>
+void get_fallback_order(const CSR& mat, BudgetFallback fallback, Vector& rows)
+{
+    thrust::host_vector<int> rowptr_h = mat.row_pointers;
+
+    rows.resize(mat.num_rows);
+    std::iota(rows.begin(), rows.end(), 0);
+    if (fallback == BudgetFallback::Degree) {
+        std::stable_sort(rows.begin(), rows.end(), [&rowptr_h](int a, int b) {
+            return rowptr_h[a + 1] - rowptr_h[a] > rowptr_h[b + 1] - rowptr_h[b];
+        });
+    }
+}
+
+// Reusable KNN -> MST -> DFS row reordering.
+// compute() only returns the permutation (new_ids[old_row] = new_row); applying it is up to the caller
+// (permute_csr_cpu, build_csr_cpu or build_csr_gpu). Nothing is printed. The workspaces are kept across
+// calls, so reordering many matrices with one Reorderer avoids reallocating them.
+class Reorderer {
+public:
+    explicit Reorderer(const ReorderOptions& options = ReorderOptions()): options(options) {}
+
+    const ReorderOptions& get_options() const
+    {
+        return options;
+    }
+
+    // KNN graph and spanning forest of the last compute() that ran the pipeline (see incremental.h)
+    const CsrMatrix<unsigned, float, host_memory>& knn_graph() const
+    {
+        return knn;
+    }
+
+    const Tree<unsigned>& spanning_forest() const
+    {
+        return tree;
+    }
+
+    template<typename CSR, typename Vector>
+    ReorderStats compute(const CSR& mat, Vector& new_ids)
+    {
+        ReorderStats   stats;
+        CPUTimer       total, timer;
+        TraceScope     scope("reorder");
+        const auto     scratch = scratch_arena().stats();
+        const Deadline deadline(options.deterministic ? 0.0 : options.time_budget_ms);
+        total.start();
+
+        ReorderCache cache(options.cache_dir);
+        uint64_t     knn_key = 0, edges_key = 0, permutation_key = 0;
+        if (cache.enabled()) {
+            knn_key         = get_knn_key(mat);
+            edges_key       = hash_combine(knn_key, 0x636c65616eULL);  // "clean"
+            permutation_key = get_permutation_key(knn_key);
+            if (cache.load_permutation(permutation_key, new_ids, mat.num_rows)) {
+                stats.permutation_cached = true;
+                total.stop();
+                stats.total_ms = total.elapsed();
+                return stats;
+            }
+            // resume after the last phase checkpointed: MST (its forest refers to the clean edges) or clean
+            tree_edges.clear();
+            roots.clear();
+            stats.edges_cached = cache.load_edges(edges_key, edges, mat.num_rows);
+            stats.mst_cached   = stats.edges_cached
+                               && cache.load_forest(get_forest_key(edges_key, edges),
+                                                    tree_edges,
+                                                    roots,
+                                                    edges.num_entries,
+                                                    mat.num_rows);
+        }
+
+        // KNN: kgraph requires an unsigned index type
+        if (!stats.edges_cached) {
+            TraceScope knn_scope("knn");
+            PerfPhase  perf;
+            timer.start();
+            stats.knn_cached = cache.load_knn(knn_key, knn);
+            if (!stats.knn_cached) {
+                build_knn(mat, deadline, stats);
+                if (!stats.knn_truncated) {
+                    cache.store_knn(knn_key, knn);
+                }
+            }
+            timer.stop();
+            stats.knn_ms   = timer.elapsed();
+            stats.knn_perf = perf.sample();
+            knn_scope.counter("rows", mat.num_rows);
+            knn_scope.counter("knn_entries", knn.num_entries);
+            ASSERT(knn.num_entries == knn.row_pointers.back() && knn.num_entries == knn.column_indices.size());
+        }
+
+        if (deadline.expired()) {
+            // no time left for clean and MST
+            use_fallback_order(mat, new_ids, stats);
+            return finish(stats, scope, total, scratch);
+        }
+
+        // csr -> coo sorted by weight
+        if (!stats.edges_cached) {
+            TraceScope clean_scope("clean");
+            PerfPhase  perf;
+            timer.start();
+            clean_graph(knn, edges);
+            timer.stop();
+            stats.clean_ms   = timer.elapsed();
+            stats.clean_perf = perf.sample();
+            if (options.checkpoints && !stats.knn_truncated) {
+                cache.store_edges(edges_key, edges);
+            }
+        }
+        stats.knn_edges = edges.num_entries;
+
+        // MST
+        {
+            TraceScope mst_scope("mst");
+            PerfPhase  perf;
+            tree.adjs.clear();
+            timer.start();
+            if (stats.mst_cached) {
+                stats.mst_weight = replay_MST(edges, tree_edges, tree);
+            }
+            else {
+                roots.clear();
+                tree_edges.clear();
+                stats.mst_weight = build_MST(
+                    edges, tree, roots, deadline, &stats.mst_truncated, options.checkpoints ? &tree_edges : nullptr);
+                if (options.checkpoints && !stats.knn_truncated && !stats.mst_truncated) {
+                    cache.store_forest(get_forest_key(edges_key, edges), tree_edges, roots);
+                }
+            }
+            timer.stop();
+            stats.mst_ms    = timer.elapsed();
+            stats.mst_perf  = perf.sample();
+            stats.num_roots = roots.size();
+            for (const auto& [node, adjs] : tree.adjs) {
+                stats.tree_edges += adjs.size();
+            }
+            stats.tree_edges /= 2;
+            mst_scope.counter("tree_edges", stats.tree_edges);
+            if (stats.mst_truncated) {
+                // bridge the components in fallback order (perform_DFS starts from the last root)
+                thrust::host_vector<int> rows, rank(mat.num_rows);
+                get_fallback_order(mat, options.fallback, rows);
+                thrust::scatter(thrust::counting_iterator<int>(0),
+                                thrust::counting_iterator<int>(mat.num_rows),
+                                rows.begin(),
+                                rank.begin());
+                std::sort(roots.begin(), roots.end(), [&rank](int a, int b) { return rank[a] > rank[b]; });
+            }
+        }
+
+        // DFS: linear like any permutation, so it runs whatever is left of the budget
+        {
+            TraceScope dfs_scope("dfs");
+            PerfPhase  perf;
+            timer.start();
+            stats.max_depth = perform_DFS(tree, roots, new_ids);
+            timer.stop();
+            stats.dfs_ms   = timer.elapsed();
+            stats.dfs_perf = perf.sample();
+            dfs_scope.counter("nodes_visited", new_ids.size());
+        }
+        ASSERT(new_ids.size() == mat.num_rows);
+        if (!stats.knn_truncated && !stats.mst_truncated) {
+            cache.store_permutation(permutation_key, new_ids);
+        }
+        return finish(stats, scope, total, scratch);
+    }
+
+private:
+    ReorderStats& finish(ReorderStats& stats, TraceScope& scope, CPUTimer& total, const ArenaStats& scratch)
+    {
+        total.stop();
+        stats.total_ms          = total.elapsed();
+        stats.scratch_allocated = scratch_arena().stats().bytes_allocated - scratch.bytes_allocated;
+        stats.scratch_reused    = scratch_arena().stats().bytes_reused - scratch.bytes_reused;
+        scope.counter("scratch_allocated", stats.scratch_allocated);
+        scope.counter("scratch_reused", stats.scratch_reused);
+        if (options.time_budget_ms > 0 && !options.deterministic) {
+            scope.counter("knn_truncated", stats.knn_truncated);
+            scope.counter("mst_truncated", stats.mst_truncated);
+            scope.counter("fallback_order", stats.fallback_order);
+        }
+        return stats;
+    }
+
+    template<typename CSR, typename Vector>
+    void use_fallback_order(const CSR& mat, Vector& new_ids, ReorderStats& stats)
+    {
+        thrust::host_vector<int> rows;
+        get_fallback_order(mat, options.fallback, rows);
+        new_ids.resize(mat.num_rows);
+        thrust::scatter(thrust::counting_iterator<int>(0),
+                        thrust::counting_iterator<int>(mat.num_rows),
+                        rows.begin(),
+                        new_ids.begin());
+        stats.fallback_order = stats.mst_truncated = true;
+    }
+
+    // KNN graph within knn_budget_share of what is left of the budget
+    template<typename CSR>
+    void build_knn(const CSR& mat, const Deadline& deadline, ReorderStats& stats)
+    {
+        convert_csr_to_adj(mat, adj, is_value_aware(options.knn_metric) ? &adj_values : nullptr);
+        stats.knn_iterations = options.knn_iterations;
+        if (deadline.expired()) {
+            // no time left after the conversion: compute() falls back before clean
+            knn.resize(mat.num_rows, mat.num_rows, 0);
+            thrust::fill(knn.row_pointers.begin(), knn.row_pointers.end(), 0);
+            stats.knn_iterations = 0;
+            stats.knn_truncated  = true;
+            return;
+        }
+        if (deadline.enabled()) {
+            // the cost model times the configured metric
+            const Deadline knn_deadline = deadline.portion(knn_budget_share);
+            with_knn_oracle(adj,
+                            options.knn_metric,
+                            &adj_values,
+                            options.knn_block_cols,
+                            nullptr,
+                            [&](const kgraph::IndexOracle& oracle) {
+                                stats.knn_iterations = plan_knn_iterations(oracle,
+                                                                           options.knn_k,
+                                                                           options.knn_l,
+                                                                           options.knn_iterations,
+                                                                           knn_deadline.remaining_ms(),
+                                                                           options.deterministic);
+                            });
+            if (stats.knn_iterations == 0) {
+                stats.knn_cooccurrence = stats.knn_truncated = true;
+                stats.knn_rows_skipped = build_KNN_cooccurrence(
+                    adj, mat.num_cols, knn, options.knn_k, knn_deadline, 64, options.knn_metric, &adj_values,
+                    options.knn_block_cols);
+                return;
+            }
+        }
+        stats.knn_truncated = stats.knn_iterations < options.knn_iterations;
+        build_KNN_from_adj(adj,
+                           knn,
+                           options.knn_k,
+                           options.knn_l,
+                           stats.knn_iterations,
+                           options.deterministic,
+                           options.seed,
+                           options.knn_metric,
+                           &adj_values,
+                           options.knn_block_cols);
+    }
+
+    // input pattern + everything the KNN graph depends on
+    template<typename CSR>
+    uint64_t get_knn_key(const CSR& mat) const
+    {
+        uint64_t key = hash_combine(hash_csr_pattern(mat), reorder_cache_version);
+        key          = hash_combine(key, options.knn_k);
+        key          = hash_combine(key, options.knn_l);
+        key          = hash_combine(key, options.knn_iterations);
+        if (options.knn_metric != KnnMetric::Hamming) {
+            key = hash_combine(key, uint64_t(options.knn_metric));
+            key = is_value_aware(options.knn_metric) ? hash_combine(key, hash_csr_values(mat)) : key;
+            key = options.knn_metric == KnnMetric::Blocks ? hash_combine(key, options.knn_block_cols) : key;
+        }
+        // keys of the default mode are unchanged, so existing cache entries stay valid
+        return options.deterministic ? hash_combine(hash_combine(key, 0x646574ULL), options.seed) : key;
+    }
+
+    // edges key + the content of the edges the forest indexes, so a forest never replays against other edges
+    template<typename COO>
+    uint64_t get_forest_key(uint64_t edges_key, const COO& coo) const
+    {
+        return hash_combine(hash_combine(edges_key, 0x6d7374ULL), hash_coo_edges(coo));  // "mst"
+    }
+
+    // KNN key + everything MST and DFS depend on
+    uint64_t get_permutation_key(uint64_t knn_key) const
+    {
+        return hash_combine(knn_key, 0x6d73742d646673ULL);  // "mst-dfs"
+    }
+
+    ReorderOptions options;
+
+    // workspaces reused across calls
+    AdjVector<int>                          adj;
+    AdjVector<float>                        adj_values;  // value-aware metrics only
+    CsrMatrix<unsigned, float, host_memory> knn;
+    CooMatrix<unsigned, float, host_memory> edges;
+    Tree<unsigned>                          tree;
+    thrust::host_vector<int>                roots;
+    thrust::host_vector<size_t>             tree_edges;  // MST edges as indices into `edges`, for checkpoints
+};
+
+inline void print_reorder_stats(const ReorderStats& stats)
+{
+    if (stats.permutation_cached) {
+        printf("[cache] permutation loaded (ms): %f \n", stats.total_ms);
+        return;
+    }
+    if (stats.mst_cached) {
+        printf("[cache] resumed from the MST checkpoint\n");
+    }
+    else if (stats.edges_cached) {
+        printf("[cache] resumed from the clean checkpoint\n");
+    }
+    else if (stats.knn_cached) {
+        printf("[cache] KNN graph loaded\n");
+    }
+    printf("[kGraph] time (ms): %f \n", stats.knn_ms);
+    print_perf_sample("kGraph", stats.knn_perf);
+    printf("[clean] time (ms): %f, edges: %zu\n", stats.clean_ms, stats.knn_edges);
+    print_perf_sample("clean", stats.clean_perf);
+    printf("[MST] time (ms): %f \n", stats.mst_ms);
+    print_perf_sample("MST", stats.mst_perf);
+    printf("total weights of MST: %.2f, tree edges: %zu, roots: %zu\n",
+           stats.mst_weight,
+           stats.tree_edges,
+           stats.num_roots);
+    printf("[DFS] time (ms): %f \n", stats.dfs_ms);
+    print_perf_sample("DFS", stats.dfs_perf);
+    printf("Max Depth: %d\n", stats.max_depth);
+    printf("[arena] scratch (MB): %.2f allocated, %.2f reused\n",
+           stats.scratch_allocated / double(1 << 20),
+           stats.scratch_reused / double(1 << 20));
+    if (stats.knn_cooccurrence) {
+        printf("[budget] KNN cut short: co-occurrence KNN, %zu rows skipped\n", stats.knn_rows_skipped);
+    }
+    else if (stats.knn_truncated) {
+        printf("[budget] KNN cut short: %u NN-descent iterations\n", stats.knn_iterations);
+    }
+    if (stats.fallback_order) {
+        printf("[budget] out of time before MST: fallback order\n");
+    }
+    else if (stats.mst_truncated) {
+        printf("[budget] MST cut short: remaining components bridged in fallback order\n");
+    }
+}
+
+template<typename CSR, typename Vector>
+auto groot(const CSR& mat, Vector& new_ids)
+{
+    Reorderer reorderer;
+    print_reorder_stats(reorderer.compute(mat, new_ids));
+}
+
+}  // namespace groot
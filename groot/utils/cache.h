@@ -0,0 +1,234 @@
+#pragma once
+#include <unistd.h>
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+namespace groot {
+
+// Content-addressed on-disk cache for the reorder pipeline.
+//
+//   <dir>/knn-<key>.gcsr    KNN graph (distances as values), keyed by the input pattern + KNN parameters
+//   <dir>/perm-<key>.garr   final new_ids, keyed by the KNN key + the MST/DFS parameters (also in the tag)
+//
+// Phase checkpoints (ReorderOptions::checkpoints), so a run that dies in MST or DFS resumes after the last
+// phase it finished, and later phases can be rerun from them:
+//   <dir>/edges-<key>.{rows,cols,weights}.garr   clean_graph output (weight-sorted COO), keyed by the KNN key
+//   <dir>/forest-<key>.{edges,roots}.garr        MST: indices of the tree edges in the clean edges, and roots,
+//                                                keyed by the edges key + the content of the edges (hash_coo_edges)
+// Every checkpoint array carries its key in the tag; a set with a missing or mismatching array, or with an
+// index out of range, is a miss.
+//
+// Keys hash row_pointers and column_indices with hash_bytes(), so the same pattern hits whatever file it
+// was read from. Entries are written to a temporary name (unique per write) and renamed, so readers never see
+// partial files; a corrupted or mismatching entry is treated as a miss.
+
+// Hash of the sparsity pattern (values are ignored: the pipeline only looks at the pattern)
+template<typename CSR>
+uint64_t hash_csr_pattern(const CSR& mat)
+{
+    using IndexType = typename CSR::index_type;
+
+    auto hash_vector = [](const auto& vec, uint64_t seed) {
+        if constexpr (std::is_same_v<typename CSR::memory_space, host_memory>) {
+            return hash_bytes(vec.data(), vec.size() * sizeof(IndexType), seed);
+        }
+        else {
+            thrust::host_vector<IndexType> host = vec;
+            return hash_bytes(host.data(), host.size() * sizeof(IndexType), seed);
+        }
+    };
+
+    uint64_t key = hash_combine(hash_combine(sizeof(IndexType), mat.num_rows), mat.num_cols);
+    key          = hash_vector(mat.row_pointers, key);
+    key          = hash_vector(mat.column_indices, key);
+    return key;
+}
+
+// Hash of a clean edge list (its size and content): ties a forest checkpoint to the edges it indexes
+template<typename COO>
+uint64_t hash_coo_edges(const COO& edges)
+{
+    using IndexType = typename COO::index_type;
+    using ValueType = typename COO::value_type;
+
+    uint64_t key = hash_combine(edges.num_rows, edges.num_entries);
+    key          = hash_bytes(edges.row_indices.data(), edges.row_indices.size() * sizeof(IndexType), key);
+    key          = hash_bytes(edges.column_indices.data(), edges.column_indices.size() * sizeof(IndexType), key);
+    return hash_bytes(edges.values.data(), edges.values.size() * sizeof(ValueType), key);
+}
+
+// Hash of the values, for the value-aware KNN metrics (combined with hash_csr_pattern)
+template<typename CSR>
+uint64_t hash_csr_values(const CSR& mat)
+{
+    using ValueType = typename CSR::value_type;
+
+    thrust::host_vector<ValueType> values = mat.values;
+    return hash_bytes(values.data(), values.size() * sizeof(ValueType), sizeof(ValueType));
+}
+
+// Every entry in [0, bound): range check of indices read back from disk (cache checkpoints, incremental state)
+template<typename Vector>
+bool all_below(const Vector& data, size_t bound)
+{
+    const int64_t n   = data.size();
+    bool          bad = false;
+#pragma omp parallel for reduction(|| : bad)
+    for (int64_t i = 0; i < n; i++) {
+        bad = bad || uint64_t(int64_t(data[i])) >= bound;  // negative indices wrap around
+    }
+    return !bad;
+}
+
+class ReorderCache {
+public:
+    explicit ReorderCache(std::string directory = ""): directory(std::move(directory))
+    {
+        if (!this->directory.empty()) {
+            std::error_code error;
+            std::filesystem::create_directories(this->directory, error);
+        }
+    }
+
+    bool enabled() const
+    {
+        return !directory.empty();
+    }
+
+    std::string knn_path(uint64_t key) const
+    {
+        return entry_path("knn", key, ".gcsr");
+    }
+
+    std::string permutation_path(uint64_t key) const
+    {
+        return entry_path("perm", key, ".garr");
+    }
+
+    template<typename CSR>
+    bool load_knn(uint64_t key, CSR& knn) const
+    {
+        const auto path = knn_path(key);
+        return enabled() && std::filesystem::exists(path) && read_from_gcsr(knn, path);
+    }
+
+    template<typename CSR>
+    bool store_knn(uint64_t key, const CSR& knn) const
+    {
+        return enabled() && commit(knn_path(key), [&](const std::string& tmp) { return write_into_gcsr(knn, tmp); });
+    }
+
+    template<typename Vector>
+    bool load_permutation(uint64_t key, Vector& new_ids, size_t num_rows) const
+    {
+        const auto path = permutation_path(key);
+        uint64_t   tag  = 0;
+        if (!enabled() || !std::filesystem::exists(path) || !read_from_garray(new_ids, path, &tag)) {
+            return false;
+        }
+        return tag == key && new_ids.size() == num_rows;
+    }
+
+    template<typename Vector>
+    bool store_permutation(uint64_t key, const Vector& new_ids) const
+    {
+        return enabled()
+               && commit(permutation_path(key), [&](const std::string& tmp) { return write_into_garray(new_ids, tmp, key); });
+    }
+
+    template<typename COO>
+    bool load_edges(uint64_t key, COO& edges, size_t num_rows) const
+    {
+        if (!enabled()) {
+            return false;
+        }
+        const bool ok = load_array(entry_path("edges", key, ".rows.garr"), key, edges.row_indices)
+                        && load_array(entry_path("edges", key, ".cols.garr"), key, edges.column_indices)
+                        && load_array(entry_path("edges", key, ".weights.garr"), key, edges.values)
+                        && edges.row_indices.size() == edges.column_indices.size()
+                        && edges.row_indices.size() == edges.values.size()
+                        && all_below(edges.row_indices, num_rows) && all_below(edges.column_indices, num_rows);
+        if (ok) {
+            edges.num_rows    = num_rows;
+            edges.num_cols    = num_rows;
+            edges.num_entries = edges.values.size();
+        }
+        return ok;
+    }
+
+    template<typename COO>
+    bool store_edges(uint64_t key, const COO& edges) const
+    {
+        return enabled() && store_array(entry_path("edges", key, ".rows.garr"), key, edges.row_indices)
+               && store_array(entry_path("edges", key, ".cols.garr"), key, edges.column_indices)
+               && store_array(entry_path("edges", key, ".weights.garr"), key, edges.values);
+    }
+
+    // `num_edges` and `num_rows` are those of the clean edges the forest refers to: a forest with an edge or
+    // a root out of range is a miss
+    template<typename EdgeVector, typename Vector>
+    bool load_forest(uint64_t key, EdgeVector& tree_edges, Vector& roots, size_t num_edges, size_t num_rows) const
+    {
+        return enabled() && load_array(entry_path("forest", key, ".edges.garr"), key, tree_edges)
+               && load_array(entry_path("forest", key, ".roots.garr"), key, roots) && all_below(tree_edges, num_edges)
+               && all_below(roots, num_rows);
+    }
+
+    template<typename EdgeVector, typename Vector>
+    bool store_forest(uint64_t key, const EdgeVector& tree_edges, const Vector& roots) const
+    {
+        return enabled() && store_array(entry_path("forest", key, ".edges.garr"), key, tree_edges)
+               && store_array(entry_path("forest", key, ".roots.garr"), key, roots);
+    }
+
+private:
+    template<typename Vector>
+    static bool load_array(const std::string& path, uint64_t key, Vector& data)
+    {
+        uint64_t tag = 0;
+        return std::filesystem::exists(path) && read_from_garray(data, path, &tag) && tag == key;
+    }
+
+    template<typename Vector>
+    static bool store_array(const std::string& path, uint64_t key, const Vector& data)
+    {
+        return commit(path, [&](const std::string& tmp) { return write_into_garray(data, tmp, key); });
+    }
+
+    std::string entry_path(const char* kind, uint64_t key, const char* extension) const
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "%s-%016" PRIx64 "%s", kind, key, extension);
+        return (std::filesystem::path(directory) / name).string();
+    }
+
+    // write through `writer` into a temporary file, then publish it atomically
+    template<typename Writer>
+    static bool commit(const std::string& path, Writer writer)
+    {
+        // unique per call: batch workers of one process may store the same key at the same time
+        static std::atomic<uint64_t> sequence{0};
+        const std::string            tmp = path + ".tmp." + std::to_string(getpid()) + "." + std::to_string(sequence++);
+        std::error_code              error;
+        if (!writer(tmp)) {
+            std::filesystem::remove(tmp, error);
+            return false;
+        }
+        std::filesystem::rename(tmp, path, error);
+        if (error) {
+            std::filesystem::remove(tmp, error);
+            return false;
+        }
+        return true;
+    }
+
+    std::string directory;
+};
+
+}  // namespace groot
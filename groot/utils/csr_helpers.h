@@ -1,4 +1,9 @@
 #pragma once
+#include <omp.h>
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
 
 namespace groot {
 
@@ -42,18 +47,29 @@ void get_row_indices_from_pointers(Vector& row_indices, const Vector& row_pointe
 
 
 
-template<typename IndexVector, typename ValueVector>
-void sort_columns_per_row(IndexVector& row_indices, IndexVector& column_indices, ValueVector& values)
+template<typename Policy, typename IndexVector, typename ValueVector>
+void sort_columns_per_row(const Policy& policy,
+                          IndexVector&  row_indices,
+                          IndexVector&  column_indices,
+                          ValueVector&  values)
 {
     // sort columns per row
-    thrust::sort_by_key(column_indices.begin(),
+    thrust::sort_by_key(policy,
+                        column_indices.begin(),
                         column_indices.end(),
                         thrust::make_zip_iterator(thrust::make_tuple(row_indices.begin(), values.begin())));
-    thrust::stable_sort_by_key(row_indices.begin(),
+    thrust::stable_sort_by_key(policy,
+                               row_indices.begin(),
                                row_indices.end(),
                                thrust::make_zip_iterator(thrust::make_tuple(column_indices.begin(), values.begin())));
 }
 
+template<typename IndexVector, typename ValueVector>
+void sort_columns_per_row(IndexVector& row_indices, IndexVector& column_indices, ValueVector& values)
+{
+    sort_columns_per_row(get_exec_policy<IndexVector>(), row_indices, column_indices, values);
+}
+
 
 template<typename IndexVector, typename ValueVector>
 void remove_duplicates(IndexVector& row_indices, IndexVector& column_indices, ValueVector& values)
@@ -72,18 +88,293 @@ void remove_duplicates(IndexVector& row_indices, IndexVector& column_indices, Va
 }
 
 
+// Split rows [0, num_rows) into `num_parts` ranges of roughly equal work (rows + nonzeros).
+// Boundaries follow the merge path: part p starts at the first row r with r + row_pointers[r] >= p * total / num_parts.
+template<typename IndexType>
+std::vector<IndexType> partition_rows_by_nnz(const IndexType* row_pointers, IndexType num_rows, int num_parts)
+{
+    std::vector<IndexType> bounds(num_parts + 1);
+    const int64_t          total = int64_t(num_rows) + row_pointers[num_rows];
+
+    bounds[0]         = 0;
+    bounds[num_parts] = num_rows;
+    for (int p = 1; p < num_parts; p++) {
+        const int64_t diagonal = total * p / num_parts;
+        IndexType     lo = 0, hi = num_rows;
+        while (lo < hi) {
+            const IndexType mid = lo + (hi - lo) / 2;
+            if (int64_t(mid) + row_pointers[mid] < diagonal) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        bounds[p] = std::max(lo, bounds[p - 1]);
+    }
+    return bounds;
+}
+
+// Rows up to this length are insertion sorted, longer rows are radix sorted
+constexpr int segment_insertion_sort_limit = 32;
+
+// Stable LSD radix sort of one row on (col - min_col), 8 bits per pass; `vals` may be null
+template<typename IndexType, typename ValueType>
+void radix_sort_segment(IndexType*              cols,
+                        ValueType*              vals,
+                        IndexType               len,
+                        std::vector<IndexType>& col_buffer,
+                        std::vector<ValueType>& val_buffer)
+{
+    using Key               = std::make_unsigned_t<IndexType>;
+    const auto [min, max]   = std::minmax_element(cols, cols + len);
+    const IndexType min_col = *min;
+    const Key       range   = Key(*max - min_col);
+
+    col_buffer.resize(len);
+    if (vals != nullptr) {
+        val_buffer.resize(len);
+    }
+    IndexType* src_col = cols;
+    IndexType* dst_col = col_buffer.data();
+    ValueType* src_val = vals;
+    ValueType* dst_val = val_buffer.data();
+
+    for (unsigned shift = 0; shift < 8 * sizeof(Key) && (range >> shift) != 0; shift += 8) {
+        IndexType bucket[256] = {};
+        for (IndexType i = 0; i < len; i++) {
+            bucket[(Key(src_col[i] - min_col) >> shift) & 255]++;
+        }
+        IndexType offset = 0;
+        for (auto& b : bucket) {
+            const IndexType count = b;
+            b                     = offset;
+            offset += count;
+        }
+        for (IndexType i = 0; i < len; i++) {
+            const IndexType dst = bucket[(Key(src_col[i] - min_col) >> shift) & 255]++;
+            dst_col[dst]        = src_col[i];
+            if (vals != nullptr) {
+                dst_val[dst] = src_val[i];
+            }
+        }
+        std::swap(src_col, dst_col);
+        std::swap(src_val, dst_val);
+    }
+    if (src_col != cols) {
+        std::copy(src_col, src_col + len, cols);
+        if (vals != nullptr) {
+            std::copy(src_val, src_val + len, vals);
+        }
+    }
+}
+
+// Sort one row by column (stable) and optionally drop repeated columns, keeping the first value.
+// Returns the new row length.
+template<typename IndexType, typename ValueType>
+IndexType sort_segment(IndexType*              cols,
+                       ValueType*              vals,
+                       IndexType               len,
+                       bool                    deduplicate,
+                       std::vector<IndexType>& col_buffer,
+                       std::vector<ValueType>& val_buffer)
+{
+    if (len <= segment_insertion_sort_limit) {
+        for (IndexType i = 1; i < len; i++) {
+            const IndexType col = cols[i];
+            const ValueType val = vals != nullptr ? vals[i] : ValueType();
+            IndexType       j   = i;
+            for (; j > 0 && cols[j - 1] > col; j--) {
+                cols[j] = cols[j - 1];
+                if (vals != nullptr) {
+                    vals[j] = vals[j - 1];
+                }
+            }
+            cols[j] = col;
+            if (vals != nullptr) {
+                vals[j] = val;
+            }
+        }
+    }
+    else if (!std::is_sorted(cols, cols + len)) {
+        radix_sort_segment(cols, vals, len, col_buffer, val_buffer);
+    }
+
+    if (!deduplicate || len == 0) {
+        return len;
+    }
+    IndexType out = 1;
+    for (IndexType i = 1; i < len; i++) {
+        if (cols[i] != cols[out - 1]) {
+            cols[out] = cols[i];
+            if (vals != nullptr) {
+                vals[out] = vals[i];
+            }
+            out++;
+        }
+    }
+    return out;
+}
+
+// Sort column indices within every row of a host CSR in place, optionally removing duplicates.
+// Rows are handed out in nnz-balanced ranges; no row-index array is materialized.
+// `values` may be null for pattern-only matrices. Rows are compacted only if duplicates were found.
+template<typename IndexVector, typename ValueVector>
+void segmented_sort_rows(IndexVector& row_pointers, IndexVector& column_indices, ValueVector* values, bool deduplicate)
+{
+    using IndexType = typename IndexVector::value_type;
+    using ValueType = typename ValueVector::value_type;
+
+    const IndexType num_rows  = row_pointers.size() - 1;
+    const int       num_parts = 4 * omp_get_max_threads();
+    const auto      bounds    = partition_rows_by_nnz(row_pointers.data(), num_rows, num_parts);
+
+    IndexType* rowptr = row_pointers.data();
+    IndexType* colidx = column_indices.data();
+    ValueType* vals   = values != nullptr ? values->data() : nullptr;
+
+    IndexVector row_len(deduplicate ? num_rows + 1 : 0);
+    bool        shrunk = false;
+
+#pragma omp parallel reduction(|| : shrunk)
+    {
+        std::vector<IndexType> col_buffer;
+        std::vector<ValueType> val_buffer;
+#pragma omp for schedule(dynamic, 1)
+        for (int p = 0; p < num_parts; p++) {
+            for (IndexType r = bounds[p]; r < bounds[p + 1]; r++) {
+                const IndexType begin = rowptr[r];
+                const IndexType len   = rowptr[r + 1] - begin;
+                const IndexType new_len =
+                    sort_segment(colidx + begin, vals ? vals + begin : nullptr, len, deduplicate, col_buffer, val_buffer);
+                if (deduplicate) {
+                    row_len[r] = new_len;
+                    shrunk     = shrunk || new_len != len;
+                }
+            }
+        }
+    }
+    if (!shrunk) {
+        return;
+    }
+
+    IndexVector new_ptr(num_rows + 1);
+    row_len[num_rows] = 0;
+    thrust::exclusive_scan(thrust::host, row_len.begin(), row_len.end(), new_ptr.begin());
+    IndexVector new_col(new_ptr[num_rows]);
+    ValueVector new_val(values != nullptr ? new_ptr[num_rows] : 0);
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int p = 0; p < num_parts; p++) {
+        for (IndexType r = bounds[p]; r < bounds[p + 1]; r++) {
+            std::copy(colidx + rowptr[r], colidx + rowptr[r] + row_len[r], new_col.data() + new_ptr[r]);
+            if (vals != nullptr) {
+                std::copy(vals + rowptr[r], vals + rowptr[r] + row_len[r], new_val.data() + new_ptr[r]);
+            }
+        }
+    }
+    row_pointers.swap(new_ptr);
+    column_indices.swap(new_col);
+    if (values != nullptr) {
+        values->swap(new_val);
+    }
+}
+
 template<typename CSR>
 void sort_columns_per_row(CSR& csr)
 {
     using IndexType = typename CSR::index_type;
 
-    thrust::device_vector<IndexType> row_indices(csr.num_entries);
-    get_row_indices_from_pointers(row_indices, csr.row_pointers);
-    remove_duplicates(row_indices, csr.column_indices, csr.values);
-    sort_columns_per_row(row_indices, csr.column_indices, csr.values);
-    get_row_pointers_from_indices(csr.row_pointers, row_indices);
-    csr.num_entries = row_indices.size();
+    if constexpr (std::is_same_v<typename CSR::memory_space, host_memory>) {
+        segmented_sort_rows(csr.row_pointers, csr.column_indices, &csr.values, true);
+        csr.num_entries = csr.row_pointers[csr.num_rows];
+    }
+    else {
+        thrust::device_vector<IndexType> row_indices(csr.num_entries);
+        get_row_indices_from_pointers(row_indices, csr.row_pointers);
+        remove_duplicates(row_indices, csr.column_indices, csr.values);
+        sort_columns_per_row(row_indices, csr.column_indices, csr.values);
+        get_row_pointers_from_indices(csr.row_pointers, row_indices);
+        csr.num_entries = row_indices.size();
+    }
 }
 
 
+// Build a CSR pattern from edges held in per-chunk buffers (typically one chunk per thread); every edge
+// (u, v) lands in row u, and also in row v when `symmetrize` is set. The buffers are released on the way.
+// Columns keep the chunk order, so the result only depends on the edges, not on the thread count, once
+// the rows are sorted with segmented_sort_rows.
+template<typename IndexVector>
+void edge_chunks_to_csr(std::vector<IndexVector>& sources,
+                        std::vector<IndexVector>& targets,
+                        int64_t                   num_rows,
+                        bool                      symmetrize,
+                        IndexVector&              row_ptr,
+                        IndexVector&              col_idx)
+{
+    using IndexType = typename IndexVector::value_type;
+
+    const int num_chunks = sources.size();
+    int64_t   num_edges  = 0;
+    for (const auto& src : sources) {
+        num_edges += src.size();
+    }
+
+    // chunks are merged into groups so that the per-group histograms stay in the order of nnz
+    const int64_t entries_per_row =
+        std::max<int64_t>(1, num_edges * (symmetrize ? 2 : 1) / std::max<int64_t>(num_rows, 1));
+    const int     num_groups      = std::clamp<int64_t>(4 * entries_per_row, 1, std::max(num_chunks, 1));
+    auto          group_begin     = [&](int g) { return int(int64_t(g) * num_chunks / num_groups); };
+
+    // every group zeroes its own histogram, so it is first touched by the thread that fills it
+    IndexVector counts(size_t(num_groups) * num_rows);
+#pragma omp parallel for schedule(static, 1)
+    for (int g = 0; g < num_groups; g++) {
+        IndexType* count = counts.data() + size_t(g) * num_rows;
+        std::fill_n(count, num_rows, IndexType(0));
+        for (int c = group_begin(g); c < group_begin(g + 1); c++) {
+            for (size_t e = 0; e < sources[c].size(); e++) {
+                const auto u = sources[c][e];
+                const auto v = targets[c][e];
+                count[u]++;
+                if (symmetrize && u != v) {
+                    count[v]++;
+                }
+            }
+        }
+    }
+
+    row_ptr.assign(num_rows + 1, 0);
+#pragma omp parallel for schedule(static)
+    for (int64_t r = 0; r < num_rows; r++) {
+        IndexType running = 0;
+        for (int g = 0; g < num_groups; g++) {
+            const IndexType tmp              = counts[size_t(g) * num_rows + r];
+            counts[size_t(g) * num_rows + r] = running;
+            running += tmp;
+        }
+        row_ptr[r] = running;
+    }
+    thrust::exclusive_scan(thrust::host, row_ptr.begin(), row_ptr.end(), row_ptr.begin());
+
+    col_idx.resize(row_ptr[num_rows]);
+#pragma omp parallel for schedule(static, 1)
+    for (int g = 0; g < num_groups; g++) {
+        IndexType* cursor = counts.data() + size_t(g) * num_rows;
+        for (int c = group_begin(g); c < group_begin(g + 1); c++) {
+            for (size_t e = 0; e < sources[c].size(); e++) {
+                const auto u = sources[c][e];
+                const auto v = targets[c][e];
+
+                col_idx[row_ptr[u] + cursor[u]++] = v;
+                if (symmetrize && u != v) {
+                    col_idx[row_ptr[v] + cursor[v]++] = u;
+                }
+            }
+            sources[c] = IndexVector();
+            targets[c] = IndexVector();
+        }
+    }
+}
+
 }  // namespace groot
\ No newline at end of file
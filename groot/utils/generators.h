@@ -0,0 +1,185 @@
+#pragma once
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace groot {
+
+// Synthetic sparse matrices for scaling studies.
+//
+// Every random draw is a hash of (seed, stream, index), so a generator returns the same matrix for any
+// thread count. Edges are produced in parallel into per-thread buffers and assembled with
+// edge_chunks_to_csr + segmented_sort_rows; values are 1. The matrices come out in their natural order
+// (banded and block-diagonal ones are then already well ordered), shuffle them with random_permutation
+// and permute_csr_cpu to give a reordering something to recover.
+
+inline uint64_t random_bits(uint64_t seed, uint64_t stream, uint64_t index)
+{
+    return mix64(hash_combine(hash_combine(seed, stream), index));
+}
+
+// uniform in [0, 1)
+inline double random_uniform(uint64_t seed, uint64_t stream, uint64_t index)
+{
+    return (random_bits(seed, stream, index) >> 11) * 0x1.0p-53;
+}
+
+// uniform in [0, n)
+inline uint64_t random_below(uint64_t seed, uint64_t stream, uint64_t index, uint64_t n)
+{
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(random_bits(seed, stream, index)) * n) >> 64);
+}
+
+// Fill `mat` (num_rows x num_cols) from `num_edges` edges, edge e being produced by make_edge(e, u, v);
+// make_edge returns false to drop an edge. Duplicates are kept unless `deduplicate` is set.
+template<typename CsrMatrix, typename EdgeFunction>
+void generate_from_edges(CsrMatrix&   mat,
+                         int64_t      num_rows,
+                         int64_t      num_cols,
+                         int64_t      num_edges,
+                         bool         deduplicate,
+                         EdgeFunction make_edge)
+{
+    using IndexType = typename CsrMatrix::index_type;
+    static_assert(std::is_same_v<typename CsrMatrix::memory_space, host_memory>, "generators build host matrices");
+
+    const int                                   num_chunks = omp_get_max_threads();
+    std::vector<HostVector<IndexType>> sources(num_chunks);
+    std::vector<HostVector<IndexType>> targets(num_chunks);
+
+#pragma omp parallel for schedule(static, 1)
+    for (int c = 0; c < num_chunks; c++) {
+        const int64_t begin = num_edges * c / num_chunks;
+        const int64_t end   = num_edges * (c + 1) / num_chunks;
+        sources[c].reserve(end - begin);
+        targets[c].reserve(end - begin);
+        for (int64_t e = begin; e < end; e++) {
+            int64_t u, v;
+            if (make_edge(e, u, v)) {
+                sources[c].push_back(u);
+                targets[c].push_back(v);
+            }
+        }
+    }
+
+    HostVector<IndexType> row_ptr, col_idx;
+    edge_chunks_to_csr(sources, targets, num_rows, false, row_ptr, col_idx);
+    HostVector<float>* no_values = nullptr;
+    segmented_sort_rows(row_ptr, col_idx, no_values, deduplicate);
+
+    const IndexType nnz = row_ptr[num_rows];
+    mat.num_rows        = num_rows;
+    mat.num_cols        = num_cols;
+    mat.num_entries     = nnz;
+    mat.row_pointers    = std::move(row_ptr);
+    mat.column_indices  = std::move(col_idx);
+    mat.values.resize(nnz);
+    thrust::fill(mat.values.begin(), mat.values.end(), 1.0);
+}
+
+// R-MAT / Kronecker graph with 2^scale vertices and edge_factor * 2^scale edges (Graph500 defaults)
+template<typename CsrMatrix>
+void generate_rmat(CsrMatrix& mat,
+                   int        scale,
+                   int        edge_factor = 16,
+                   double     a           = 0.57,
+                   double     b           = 0.19,
+                   double     c           = 0.19,
+                   uint64_t   seed        = 1,
+                   bool       deduplicate = true)
+{
+    const int64_t n = int64_t(1) << scale;
+    generate_from_edges(mat, n, n, n * edge_factor, deduplicate, [=](int64_t e, int64_t& u, int64_t& v) {
+        u = v = 0;
+        for (int level = 0; level < scale; level++) {
+            const double r = random_uniform(seed, level, e);
+            u              = 2 * u + (r >= a + b);
+            v              = 2 * v + ((r >= a && r < a + b) || r >= a + b + c);
+        }
+        return true;
+    });
+}
+
+// G(n, m) random matrix with round(num_rows * avg_degree) uniformly placed entries
+template<typename CsrMatrix>
+void generate_erdos_renyi(CsrMatrix& mat,
+                          int64_t    num_rows,
+                          int64_t    num_cols,
+                          double     avg_degree,
+                          uint64_t   seed        = 1,
+                          bool       deduplicate = true)
+{
+    const int64_t num_edges = std::llround(num_rows * avg_degree);
+    generate_from_edges(mat, num_rows, num_cols, num_edges, deduplicate, [=](int64_t e, int64_t& u, int64_t& v) {
+        u = random_below(seed, 0, e, num_rows);
+        v = random_below(seed, 1, e, num_cols);
+        return true;
+    });
+}
+
+// Square matrix with entries |i - j| <= half_bandwidth, each kept with probability `fill`
+template<typename CsrMatrix>
+void generate_banded(CsrMatrix& mat, int64_t num_rows, int64_t half_bandwidth, double fill = 1.0, uint64_t seed = 1)
+{
+    const int64_t width = 2 * half_bandwidth + 1;
+    generate_from_edges(mat, num_rows, num_rows, num_rows * width, false, [=](int64_t e, int64_t& u, int64_t& v) {
+        u = e / width;
+        v = u - half_bandwidth + e % width;
+        return v >= 0 && v < num_rows && (fill >= 1.0 || random_uniform(seed, 0, e) < fill);
+    });
+}
+
+// Square matrix of dense-ish diagonal blocks (each entry kept with probability `density`) plus
+// num_rows * noise_degree uniformly placed off-block entries
+template<typename CsrMatrix>
+void generate_block_diagonal(CsrMatrix& mat,
+                             int64_t    num_rows,
+                             int64_t    block_size,
+                             double     density,
+                             double     noise_degree,
+                             uint64_t   seed = 1)
+{
+    const int64_t block_edges = num_rows * block_size;  // upper bound, the last block may be smaller
+    const int64_t noise_edges = std::llround(num_rows * noise_degree);
+    generate_from_edges(
+        mat, num_rows, num_rows, block_edges + noise_edges, true, [=](int64_t e, int64_t& u, int64_t& v) {
+            if (e < block_edges) {
+                u = e / block_size;
+                v = u / block_size * block_size + e % block_size;
+                return v < num_rows && random_uniform(seed, 0, e) < density;
+            }
+            u = random_below(seed, 1, e, num_rows);
+            v = random_below(seed, 2, e, num_rows);
+            return true;
+        });
+}
+
+// Square matrix whose rows repeat a few distinct columns: avg_degree entries per row drawn from
+// max(1, avg_degree / repeats) candidates. Duplicates are kept to stress the deduplication paths.
+template<typename CsrMatrix>
+void generate_duplicate_heavy(CsrMatrix& mat, int64_t num_rows, int avg_degree, int repeats = 4, uint64_t seed = 1)
+{
+    const int64_t distinct = std::max(1, avg_degree / std::max(repeats, 1));
+    generate_from_edges(
+        mat, num_rows, num_rows, num_rows * avg_degree, false, [=](int64_t e, int64_t& u, int64_t& v) {
+            u = e / avg_degree;
+            v = random_below(seed, u, random_below(seed, 0, e, distinct), num_rows);
+            return true;
+        });
+}
+
+// Uniformly random permutation of [0, n) (Fisher-Yates on counter-based draws)
+template<typename Vector>
+void random_permutation(Vector& perm, int64_t n, uint64_t seed = 1)
+{
+    perm.resize(n);
+    thrust::sequence(perm.begin(), perm.end(), 0);
+    for (int64_t i = n - 1; i > 0; i--) {
+        std::swap(perm[i], perm[random_below(seed, 0, i, i + 1)]);
+    }
+}
+
+}  // namespace groot
@@ -0,0 +1,75 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace groot {
+
+// murmur3 finalizer
+inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+inline uint64_t hash_combine(uint64_t seed, uint64_t value)
+{
+    return mix64(seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
+
+// Hash of one contiguous block; four independent lanes keep the multiply chains short
+inline uint64_t hash_block(const unsigned char* data, size_t bytes, uint64_t seed)
+{
+    constexpr uint64_t prime = 0x9e3779b97f4a7c15ULL;
+    uint64_t           lane[4] = {seed, seed ^ prime, seed + prime, seed - prime};
+
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        for (int l = 0; l < 4; l++) {
+            uint64_t word;
+            std::memcpy(&word, data + i + 8 * l, 8);
+            lane[l] = (lane[l] ^ mix64(word)) * prime;
+        }
+    }
+    uint64_t h = bytes;
+    for (int l = 0; l < 4; l++) {
+        h = hash_combine(h, lane[l]);
+    }
+    for (; i < bytes; i += 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, data + i, std::min<size_t>(8, bytes - i));
+        h = hash_combine(h, word);
+    }
+    return h;
+}
+
+// Parallel 64-bit hash of a byte range.
+// The range is cut into fixed 1 MiB blocks that are hashed independently and folded in order,
+// so the result does not depend on the number of threads.
+inline uint64_t hash_bytes(const void* data, size_t bytes, uint64_t seed = 0)
+{
+    constexpr size_t block_bytes = size_t(1) << 20;
+    const auto*      ptr         = static_cast<const unsigned char*>(data);
+    const int64_t    num_blocks  = (bytes + block_bytes - 1) / block_bytes;
+
+    std::vector<uint64_t> block_hashes(num_blocks);
+#pragma omp parallel for schedule(static)
+    for (int64_t b = 0; b < num_blocks; b++) {
+        const size_t begin = b * block_bytes;
+        const size_t len   = std::min(block_bytes, bytes - begin);
+        block_hashes[b]    = hash_block(ptr + begin, len, seed + b);
+    }
+
+    uint64_t h = hash_combine(seed, bytes);
+    for (const auto bh : block_hashes) {
+        h = hash_combine(h, bh);
+    }
+    return h;
+}
+
+}  // namespace groot
@@ -0,0 +1,163 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <type_traits>
+
+namespace groot {
+
+// Versioned binary container for one flat array (`.garr`), e.g. a permutation
+//
+//   [GarrayHeader (64 B)] [data]
+//
+// The data starts on a 64-byte boundary, so a mapped file can be used in place. `tag` is free for the
+// writer (the reorder cache stores its key there) and `checksum` is hash_bytes() over the data.
+constexpr char     garray_magic[8] = {'G', 'R', 'O', 'O', 'T', 'A', 'R', 'R'};
+constexpr uint32_t garray_version  = 1;
+
+struct GarrayHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_bytes;
+    uint8_t  value_type;  // GcsrValueType
+    uint8_t  reserved0[7];
+    uint64_t count;
+    uint64_t tag;
+    uint64_t checksum;
+    uint64_t reserved[2];
+};
+static_assert(sizeof(GarrayHeader) == 64 && sizeof(GarrayHeader) % gcsr_alignment == 0);
+
+inline bool validate_garray(const MappedFile& file, GarrayHeader& header, bool verify_checksum)
+{
+    if (file.size() < sizeof(GarrayHeader)) {
+        std::cout << "garr file is truncated!" << std::endl;
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(GarrayHeader));
+
+    if (std::memcmp(header.magic, garray_magic, sizeof(garray_magic)) != 0) {
+        std::cout << "not a garr file!" << std::endl;
+        return false;
+    }
+    if (header.version != garray_version || header.header_bytes != sizeof(GarrayHeader)) {
+        std::cout << "garr version " << header.version << " is NOT supported!" << std::endl;
+        return false;
+    }
+    const size_t width = gcsr_value_width(header.value_type);
+    if (width == 0 || header.count > (file.size() - sizeof(GarrayHeader)) / width) {
+        std::cout << "garr header is corrupted!" << std::endl;
+        return false;
+    }
+    if (verify_checksum && hash_bytes(file.data() + sizeof(GarrayHeader), header.count * width) != header.checksum) {
+        std::cout << "garr checksum mismatch!" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Zero-copy view of a `.garr` file holding elements of type T
+template<typename T>
+struct MappedGarray {
+    MappedFile   file;
+    GarrayHeader header;
+    const T*     data{nullptr};
+
+    size_t size() const
+    {
+        return header.count;
+    }
+};
+
+template<typename T>
+bool map_garray_file(MappedGarray<T>&   view,
+                     const std::string& filename,
+                     bool               verify_checksum = true,
+                     MmapHint           hint            = MmapHint::WillNeed)
+{
+    if (!view.file.open(filename, hint)) {
+        return false;
+    }
+    if (!validate_garray(view.file, view.header, verify_checksum)) {
+        return false;
+    }
+    if (view.header.value_type != static_cast<uint8_t>(gcsr_value_type<T>())) {
+        std::cout << "garr value type does not match!" << std::endl;
+        return false;
+    }
+    view.data = view.file.template as<T>(sizeof(GarrayHeader));
+    return true;
+}
+
+// Read any integer `.garr` into `data` (converted to its value type); `tag` receives the header tag
+template<typename Vector>
+bool read_from_garray(Vector& data, const std::string& filename, uint64_t* tag = nullptr, bool verify = true)
+{
+    MappedFile   file;
+    GarrayHeader header;
+    if (!file.open(filename, MmapHint::Sequential)) {
+        std::cout << "Cannot open the input file!" << std::endl;
+        return false;
+    }
+    if (!validate_garray(file, header, verify)) {
+        return false;
+    }
+
+    const char* src = file.data() + sizeof(GarrayHeader);
+    bool        fits = false;
+    switch (static_cast<GcsrValueType>(header.value_type)) {
+        case GcsrValueType::Int32:
+            fits = assign_gcsr_array<int32_t>(data, src, header.count);
+            break;
+        case GcsrValueType::Int64:
+            fits = assign_gcsr_array<int64_t>(data, src, header.count);
+            break;
+        case GcsrValueType::Float32:
+            fits = assign_gcsr_array<float>(data, src, header.count);
+            break;
+        case GcsrValueType::Float64:
+            fits = assign_gcsr_array<double>(data, src, header.count);
+            break;
+        default:
+            return false;
+    }
+    if (!fits) {
+        std::cout << "garr values do not fit the requested type!" << std::endl;
+        return false;
+    }
+    if (tag != nullptr) {
+        *tag = header.tag;
+    }
+    return true;
+}
+
+// Prints nothing (the reorder cache stores through it): false when the file cannot be written
+template<typename Vector>
+bool write_into_garray(const Vector& data, const std::string& output, uint64_t tag = 0)
+{
+    using T = typename Vector::value_type;
+    static_assert(gcsr_value_type<T>() != GcsrValueType::None, "garr holds 4/8-byte integers or floats");
+
+    thrust::host_vector<T> host = data;
+
+    GarrayHeader header{};
+    std::memcpy(header.magic, garray_magic, sizeof(garray_magic));
+    header.version      = garray_version;
+    header.header_bytes = sizeof(GarrayHeader);
+    header.value_type   = static_cast<uint8_t>(gcsr_value_type<T>());
+    header.count        = host.size();
+    header.tag          = tag;
+    header.checksum     = hash_bytes(host.data(), host.size() * sizeof(T));
+
+    FILE* fp = fopen(output.c_str(), "wb");
+    if (fp == NULL) {
+        return false;
+    }
+    const bool ok = fwrite(&header, sizeof(GarrayHeader), 1, fp) == 1
+                    && fwrite(host.data(), sizeof(T), host.size(), fp) == host.size();
+    return fclose(fp) == 0 && ok;
+}
+
+}  // namespace groot
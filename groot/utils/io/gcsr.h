@@ -0,0 +1,441 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace groot {
+
+// Versioned binary sparse container (`.gcsr`)
+//
+//   [GcsrHeader (128 B)] [row_ptr] [col_idx] [values]? [permutation]?
+//
+// Every array starts on a 64-byte boundary, so a mapped file can be used in place.
+// Row pointers use `offset_width` bytes, column indices and the permutation use `index_width` bytes.
+// `checksum` chains hash_bytes() over the arrays in file order (padding excluded).
+enum class GcsrValueType : uint8_t { None = 0, Float32 = 1, Float64 = 2, Int32 = 3, Int64 = 4 };
+
+enum GcsrFlags : uint8_t { GCSR_HAS_VALUES = 1, GCSR_HAS_PERMUTATION = 2 };
+
+constexpr char     gcsr_magic[8]  = {'G', 'R', 'O', 'O', 'T', 'C', 'S', 'R'};
+constexpr uint32_t gcsr_version   = 1;
+constexpr size_t   gcsr_alignment = 64;
+
+struct GcsrHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_bytes;
+    uint8_t  index_width;
+    uint8_t  offset_width;
+    uint8_t  value_type;
+    uint8_t  flags;
+    uint32_t reserved0;
+    uint64_t num_rows;
+    uint64_t num_cols;
+    uint64_t num_entries;
+    uint64_t row_pointers_offset;
+    uint64_t column_indices_offset;
+    uint64_t values_offset;
+    uint64_t permutation_offset;
+    uint64_t file_bytes;
+    uint64_t checksum;
+    uint64_t reserved[4];
+};
+static_assert(sizeof(GcsrHeader) == 128 && sizeof(GcsrHeader) % gcsr_alignment == 0);
+
+inline size_t gcsr_align(size_t offset)
+{
+    return (offset + gcsr_alignment - 1) / gcsr_alignment * gcsr_alignment;
+}
+
+template<typename T>
+constexpr GcsrValueType gcsr_value_type()
+{
+    if constexpr (std::is_same_v<T, float>) {
+        return GcsrValueType::Float32;
+    }
+    else if constexpr (std::is_same_v<T, double>) {
+        return GcsrValueType::Float64;
+    }
+    else if constexpr (std::is_integral_v<T> && sizeof(T) == 4) {
+        return GcsrValueType::Int32;
+    }
+    else if constexpr (std::is_integral_v<T> && sizeof(T) == 8) {
+        return GcsrValueType::Int64;
+    }
+    else {
+        return GcsrValueType::None;
+    }
+}
+
+inline size_t gcsr_value_width(uint8_t type)
+{
+    switch (static_cast<GcsrValueType>(type)) {
+        case GcsrValueType::Float32:
+        case GcsrValueType::Int32:
+            return 4;
+        case GcsrValueType::Float64:
+        case GcsrValueType::Int64:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+// End of an array of `count` elements of `width` bytes starting at `offset`, aligned; false on overflow
+inline bool gcsr_array_end(size_t offset, uint64_t count, size_t width, size_t& end)
+{
+    const size_t room = std::numeric_limits<size_t>::max() - offset - gcsr_alignment;
+    if (offset > std::numeric_limits<size_t>::max() - gcsr_alignment || (width != 0 && count > room / width)) {
+        return false;
+    }
+    end = gcsr_align(offset + count * width);
+    return true;
+}
+
+// Fill in the array offsets and the file size from the dimensions, widths and flags. False when the counts
+// (e.g. those of a crafted header) overflow the layout.
+inline bool gcsr_layout(GcsrHeader& header)
+{
+    if (header.num_rows == std::numeric_limits<uint64_t>::max()) {
+        return false;
+    }
+    size_t offset              = gcsr_align(sizeof(GcsrHeader));
+    header.row_pointers_offset = offset;
+    if (!gcsr_array_end(offset, header.num_rows + 1, header.offset_width, offset)) {
+        return false;
+    }
+
+    header.column_indices_offset = offset;
+    if (!gcsr_array_end(offset, header.num_entries, header.index_width, offset)) {
+        return false;
+    }
+
+    header.values_offset = 0;
+    if (header.flags & GCSR_HAS_VALUES) {
+        header.values_offset = offset;
+        if (!gcsr_array_end(offset, header.num_entries, gcsr_value_width(header.value_type), offset)) {
+            return false;
+        }
+    }
+
+    header.permutation_offset = 0;
+    if (header.flags & GCSR_HAS_PERMUTATION) {
+        header.permutation_offset = offset;
+        if (!gcsr_array_end(offset, header.num_rows, header.index_width, offset)) {
+            return false;
+        }
+    }
+    header.file_bytes = offset;
+    return true;
+}
+
+// Checksum over the arrays, given a pointer to each of them (null for absent arrays)
+inline uint64_t gcsr_checksum(const GcsrHeader& header,
+                              const void*       row_pointers,
+                              const void*       column_indices,
+                              const void*       values,
+                              const void*       permutation)
+{
+    uint64_t checksum = hash_combine(header.num_rows, header.num_entries);
+    checksum          = hash_bytes(row_pointers, (header.num_rows + 1) * header.offset_width, checksum);
+    checksum          = hash_bytes(column_indices, header.num_entries * header.index_width, checksum);
+    if (values != nullptr) {
+        checksum = hash_bytes(values, header.num_entries * gcsr_value_width(header.value_type), checksum);
+    }
+    if (permutation != nullptr) {
+        checksum = hash_bytes(permutation, header.num_rows * header.index_width, checksum);
+    }
+    return checksum;
+}
+
+inline bool validate_gcsr(const MappedFile& file, GcsrHeader& header, bool verify_checksum)
+{
+    if (file.size() < sizeof(GcsrHeader)) {
+        std::cout << "gcsr file is truncated!" << std::endl;
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(GcsrHeader));
+
+    if (std::memcmp(header.magic, gcsr_magic, sizeof(gcsr_magic)) != 0) {
+        std::cout << "not a gcsr file!" << std::endl;
+        return false;
+    }
+    if (header.version != gcsr_version || header.header_bytes != sizeof(GcsrHeader)) {
+        std::cout << "gcsr version " << header.version << " is NOT supported!" << std::endl;
+        return false;
+    }
+    if ((header.index_width != 4 && header.index_width != 8) || (header.offset_width != 4 && header.offset_width != 8)
+        || ((header.flags & GCSR_HAS_VALUES) && gcsr_value_width(header.value_type) == 0)) {
+        std::cout << "gcsr header is corrupted!" << std::endl;
+        return false;
+    }
+
+    GcsrHeader expected = header;
+    if (!gcsr_layout(expected) || std::memcmp(&expected, &header, sizeof(GcsrHeader)) != 0
+        || file.size() < header.file_bytes) {
+        std::cout << "gcsr layout does not match its header!" << std::endl;
+        return false;
+    }
+
+    if (verify_checksum) {
+        const auto checksum =
+            gcsr_checksum(header,
+                          file.data() + header.row_pointers_offset,
+                          file.data() + header.column_indices_offset,
+                          header.values_offset ? file.data() + header.values_offset : nullptr,
+                          header.permutation_offset ? file.data() + header.permutation_offset : nullptr);
+        if (checksum != header.checksum) {
+            std::cout << "gcsr checksum mismatch!" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// The dimensions of the file are representable as IndexType
+template<typename IndexType>
+bool gcsr_counts_fit(const GcsrHeader& header)
+{
+    if (std::in_range<IndexType>(header.num_rows) && std::in_range<IndexType>(header.num_cols)
+        && std::in_range<IndexType>(header.num_entries)) {
+        return true;
+    }
+    std::cout << "gcsr dimensions do not fit the requested index type!" << std::endl;
+    return false;
+}
+
+// Zero-copy view of a `.gcsr` file whose widths and value type match IndexType/ValueType.
+// `values` and `permutation` are null when the file does not carry them.
+template<typename IndexType, typename ValueType>
+struct MappedGcsr {
+    MappedFile file;
+    GcsrHeader header;
+
+    IndexType num_rows{0};
+    IndexType num_cols{0};
+    IndexType num_entries{0};
+
+    const IndexType* row_pointers{nullptr};
+    const IndexType* column_indices{nullptr};
+    const ValueType* values{nullptr};
+    const IndexType* permutation{nullptr};
+};
+
+template<typename IndexType, typename ValueType>
+bool map_gcsr_file(MappedGcsr<IndexType, ValueType>& view,
+                   const std::string&                filename,
+                   MmapHint                          hint            = MmapHint::None,
+                   bool                              verify_checksum = false)
+{
+    if (!view.file.open(filename, hint) || !validate_gcsr(view.file, view.header, verify_checksum)) {
+        return false;
+    }
+    const auto& header = view.header;
+    if (header.index_width != sizeof(IndexType) || header.offset_width != sizeof(IndexType)) {
+        std::cout << "gcsr index width does not match the requested index type!" << std::endl;
+        return false;
+    }
+    if (header.values_offset && header.value_type != static_cast<uint8_t>(gcsr_value_type<ValueType>())) {
+        std::cout << "gcsr value type does not match the requested value type!" << std::endl;
+        return false;
+    }
+    if (!gcsr_counts_fit<IndexType>(header)) {
+        return false;
+    }
+
+    view.num_rows       = header.num_rows;
+    view.num_cols       = header.num_cols;
+    view.num_entries    = header.num_entries;
+    view.row_pointers   = view.file.template as<IndexType>(header.row_pointers_offset);
+    view.column_indices = view.file.template as<IndexType>(header.column_indices_offset);
+    view.values         = header.values_offset ? view.file.template as<ValueType>(header.values_offset) : nullptr;
+    view.permutation = header.permutation_offset ? view.file.template as<IndexType>(header.permutation_offset) : nullptr;
+    return true;
+}
+
+// Copy `n` elements of type Src into dst, converting only when the representations differ.
+// False when a narrowing integer conversion loses a value (e.g. 8-byte or unsigned indices above the maximum
+// of an int matrix); same-width signed data keeps its bits, as the format does not record signedness.
+template<typename Src, typename Vector>
+bool assign_gcsr_array(Vector& dst, const char* src, size_t n)
+{
+    using T                  = typename Vector::value_type;
+    const Src*     ptr       = reinterpret_cast<const Src*>(src);
+    constexpr bool integers  = std::is_integral_v<Src> && std::is_integral_v<T>;
+    constexpr bool narrowing = sizeof(Src) > sizeof(T)
+                               || (sizeof(Src) == sizeof(T) && std::is_unsigned_v<Src> && std::is_signed_v<T>);
+    if constexpr (integers && narrowing) {
+        bool bad = false;
+#pragma omp parallel for reduction(|| : bad)
+        for (int64_t i = 0; i < int64_t(n); i++) {
+            bad = bad || !std::in_range<T>(ptr[i]);
+        }
+        if (bad) {
+            return false;
+        }
+    }
+    if constexpr (sizeof(Src) == sizeof(T) && std::is_integral_v<Src> == std::is_integral_v<T>) {
+        const T* same = reinterpret_cast<const T*>(src);
+        dst.assign(same, same + n);
+    }
+    else {
+        thrust::host_vector<T> tmp(n);
+#pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < int64_t(n); i++) {
+            tmp[i] = static_cast<T>(ptr[i]);
+        }
+        dst = tmp;
+    }
+    return true;
+}
+
+template<typename Vector>
+bool assign_gcsr_indices(Vector& dst, const char* src, size_t n, size_t width)
+{
+    if (width == 4) {
+        return assign_gcsr_array<uint32_t>(dst, src, n);
+    }
+    return assign_gcsr_array<uint64_t>(dst, src, n);
+}
+
+template<class CsrMatrix, typename Vector = thrust::host_vector<int>>
+bool read_from_gcsr(CsrMatrix&         matrix,
+                    const std::string& filename,
+                    Vector*            permutation     = nullptr,
+                    bool               verify_checksum = true)
+{
+    MappedFile file;
+    GcsrHeader header;
+    if (!file.open(filename, MmapHint::Sequential)) {
+        std::cout << "cannot open gcsr file!" << std::endl;
+        return false;
+    }
+    using IndexType = typename CsrMatrix::index_type;
+    if (!validate_gcsr(file, header, verify_checksum) || !gcsr_counts_fit<IndexType>(header)) {
+        return false;
+    }
+
+    matrix.num_rows    = header.num_rows;
+    matrix.num_cols    = header.num_cols;
+    matrix.num_entries = header.num_entries;
+    const char* row_pointers   = file.data() + header.row_pointers_offset;
+    const char* column_indices = file.data() + header.column_indices_offset;
+    if (!assign_gcsr_indices(matrix.row_pointers, row_pointers, header.num_rows + 1, header.offset_width)
+        || !assign_gcsr_indices(matrix.column_indices, column_indices, header.num_entries, header.index_width)) {
+        std::cout << "gcsr indices do not fit the requested index type!" << std::endl;
+        return false;
+    }
+
+    const char* values = file.data() + header.values_offset;
+    switch (header.values_offset ? static_cast<GcsrValueType>(header.value_type) : GcsrValueType::None) {
+        case GcsrValueType::Float32:
+            assign_gcsr_array<float>(matrix.values, values, header.num_entries);
+            break;
+        case GcsrValueType::Float64:
+            assign_gcsr_array<double>(matrix.values, values, header.num_entries);
+            break;
+        case GcsrValueType::Int32:
+            assign_gcsr_array<int32_t>(matrix.values, values, header.num_entries);
+            break;
+        case GcsrValueType::Int64:
+            assign_gcsr_array<int64_t>(matrix.values, values, header.num_entries);
+            break;
+        default:
+            matrix.values.resize(header.num_entries);
+            thrust::fill(matrix.values.begin(), matrix.values.end(), 1.0);
+    }
+
+    if (permutation != nullptr) {
+        if (!header.permutation_offset) {
+            permutation->clear();
+        }
+        else if (!assign_gcsr_indices(
+                     *permutation, file.data() + header.permutation_offset, header.num_rows, header.index_width)) {
+            std::cout << "gcsr permutation does not fit the requested index type!" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Prints nothing (the reorder cache stores through it): false, with the partial file removed, when the file
+// cannot be written. try_write_matrix_file reports progress and failures for the CLI.
+template<typename CsrMatrix, typename Vector = thrust::host_vector<int>>
+bool write_into_gcsr(const CsrMatrix& mat, std::string output, const Vector* permutation = nullptr)
+{
+    using IndexType = typename CsrMatrix::index_type;
+    using ValueType = typename CsrMatrix::value_type;
+    using PermType  = std::conditional_t<sizeof(IndexType) == 8, uint64_t, uint32_t>;
+
+    thrust::host_vector<IndexType> row_ptr = mat.row_pointers;
+    thrust::host_vector<IndexType> col_idx = mat.column_indices;
+    thrust::host_vector<ValueType> values  = mat.values;
+    thrust::host_vector<PermType>  perm;
+    ASSERT(row_ptr[mat.num_rows] == mat.num_entries && "row_ptr[nrow] != nnz");
+
+    GcsrHeader header{};
+    std::memcpy(header.magic, gcsr_magic, sizeof(gcsr_magic));
+    header.version      = gcsr_version;
+    header.header_bytes = sizeof(GcsrHeader);
+    header.index_width  = sizeof(IndexType);
+    header.offset_width = sizeof(IndexType);
+    header.value_type   = static_cast<uint8_t>(gcsr_value_type<ValueType>());
+    header.num_rows     = mat.num_rows;
+    header.num_cols     = mat.num_cols;
+    header.num_entries  = mat.num_entries;
+    if (header.value_type != static_cast<uint8_t>(GcsrValueType::None)) {
+        header.flags |= GCSR_HAS_VALUES;
+    }
+    if (permutation != nullptr && !permutation->empty()) {
+        ASSERT(permutation->size() == size_t(mat.num_rows));
+        perm = *permutation;
+        header.flags |= GCSR_HAS_PERMUTATION;
+    }
+    if (!gcsr_layout(header)) {
+        return false;
+    }
+    header.checksum = gcsr_checksum(header,
+                                    row_ptr.data(),
+                                    col_idx.data(),
+                                    (header.flags & GCSR_HAS_VALUES) ? values.data() : nullptr,
+                                    (header.flags & GCSR_HAS_PERMUTATION) ? perm.data() : nullptr);
+
+    FILE* fp = fopen(output.c_str(), "wb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    // write `bytes` at `offset`, zero-filling the gap left by the previous array; false on a short write
+    size_t position = 0;
+    auto   write_at = [&](size_t offset, const void* data, size_t bytes) {
+        static const char zeros[gcsr_alignment] = {};
+        ASSERT(offset >= position && offset - position <= gcsr_alignment);
+        const size_t gap = offset - position;
+        position         = offset + bytes;
+        return (gap == 0 || fwrite(zeros, 1, gap, fp) == gap)
+               && (bytes == 0 || (data != nullptr && fwrite(data, 1, bytes, fp) == bytes));
+    };
+    bool ok = write_at(0, &header, sizeof(GcsrHeader))
+              && write_at(header.row_pointers_offset, row_ptr.data(), (header.num_rows + 1) * sizeof(IndexType))
+              && write_at(header.column_indices_offset, col_idx.data(), header.num_entries * sizeof(IndexType));
+    if (ok && header.values_offset) {
+        ok = write_at(header.values_offset, values.data(), header.num_entries * sizeof(ValueType));
+    }
+    if (ok && header.permutation_offset) {
+        ok = write_at(header.permutation_offset, perm.data(), header.num_rows * sizeof(PermType));
+    }
+    ok = ok && write_at(header.file_bytes, nullptr, 0);
+
+    if (fclose(fp) != 0 || !ok) {
+        std::remove(output.c_str());
+        return false;
+    }
+    return true;
+}
+
+}  // namespace groot
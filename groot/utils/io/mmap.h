@@ -0,0 +1,128 @@
+#pragma once
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+namespace groot {
+
+// Access hints for a mapped file
+//   Populate   : pre-fault every page at map time (MAP_POPULATE)
+//   Sequential : the file is consumed front to back (MADV_SEQUENTIAL)
+//   WillNeed   : start asynchronous read-ahead of the whole file (MADV_WILLNEED)
+enum class MmapHint { None = 0, Populate = 1, Sequential = 2, WillNeed = 3 };
+
+// Read-only, private mapping of a whole file.
+// The mapping lives as long as the object; views handed out by `as<T>()` must not outlive it.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& filename, MmapHint hint = MmapHint::None)
+    {
+        open(filename, hint);
+    }
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept:
+        addr(std::exchange(other.addr, nullptr)), length(std::exchange(other.length, 0))
+    {
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other) {
+            close();
+            addr   = std::exchange(other.addr, nullptr);
+            length = std::exchange(other.length, 0);
+        }
+        return *this;
+    }
+
+    bool open(const std::string& filename, MmapHint hint = MmapHint::None)
+    {
+        close();
+
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        if (hint == MmapHint::Populate) {
+            flags |= MAP_POPULATE;
+        }
+#endif
+        void* ptr = mmap(nullptr, st.st_size, PROT_READ, flags, fd, 0);
+        // the mapping keeps its own reference to the file
+        ::close(fd);
+        if (ptr == MAP_FAILED) {
+            return false;
+        }
+
+        addr   = ptr;
+        length = st.st_size;
+
+        if (hint == MmapHint::Sequential) {
+            madvise(addr, length, MADV_SEQUENTIAL);
+        }
+        else if (hint == MmapHint::WillNeed) {
+            madvise(addr, length, MADV_WILLNEED);
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (addr != nullptr) {
+            munmap(addr, length);
+        }
+        addr   = nullptr;
+        length = 0;
+    }
+
+    bool is_open() const
+    {
+        return addr != nullptr;
+    }
+
+    const char* data() const
+    {
+        return static_cast<const char*>(addr);
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+    template<typename T>
+    const T* as(size_t offset) const
+    {
+        return reinterpret_cast<const T*>(data() + offset);
+    }
+
+private:
+    void*  addr   = nullptr;
+    size_t length = 0;
+};
+
+}  // namespace groot
@@ -0,0 +1,64 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <vector>
+
+namespace groot {
+
+// Helpers for parsing memory-mapped text files in parallel.
+// All functions work on [p, end) and never read past `end`.
+
+inline bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skip_blanks(const char* p, const char* end)
+{
+    while (p < end && is_blank(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+// Position right after the next '\n' (or `end`)
+inline const char* next_line(const char* p, const char* end)
+{
+    const void* nl = std::memchr(p, '\n', end - p);
+    return nl == nullptr ? end : static_cast<const char*>(nl) + 1;
+}
+
+// Parse one number after optional blanks and an optional '+'.
+// Returns the position after the number, or nullptr if the line holds no further number.
+template<typename T>
+const char* parse_number(const char* p, const char* end, T& value)
+{
+    p = skip_blanks(p, end);
+    if (p < end && *p == '+') {
+        ++p;
+    }
+    auto [ptr, ec] = std::from_chars(p, end, value);
+    if (ec != std::errc() || ptr == p) {
+        return nullptr;
+    }
+    return ptr;
+}
+
+// Split [begin, end) into `num_chunks` pieces whose boundaries sit right after a '\n'.
+// Returns num_chunks + 1 boundaries; empty chunks are possible for tiny inputs.
+inline std::vector<const char*> split_lines(const char* begin, const char* end, int num_chunks)
+{
+    std::vector<const char*> bounds(num_chunks + 1);
+    const size_t             length = end - begin;
+
+    bounds[0]          = begin;
+    bounds[num_chunks] = end;
+    for (int c = 1; c < num_chunks; c++) {
+        const char* guess = begin + length / num_chunks * c;
+        bounds[c]         = std::max(bounds[c - 1], guess == begin ? begin : next_line(guess - 1, end));
+    }
+    return bounds;
+}
+
+}  // namespace groot
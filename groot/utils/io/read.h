@@ -4,6 +4,7 @@
 #include <fstream>
 #include <iostream>
 #include <limits>
+#include <omp.h>
 #include <regex>
 #include <type_traits>
 #include <vector>
@@ -188,6 +189,216 @@ int read_from_mtx(CsrMatrix& matrix, std::string input)
     return 0;
 }
 
+enum class MtxField { Real, Complex, Integer, Pattern };
+
+enum class MtxLine { Skip, Entry, Malformed };
+
+// Parse one `row col [value [imag]]` line of a Matrix Market file.
+// Blank and comment lines are skipped; a line whose fields do not parse is malformed. Indices stay 1-based.
+template<bool ParseValue>
+MtxLine parse_mtx_entry(const char* p, const char* end, MtxField field, int& idxi, int& idxj, double& fval)
+{
+    p = skip_blanks(p, end);
+    if (p == end || *p == '\n' || *p == '%') {
+        return MtxLine::Skip;
+    }
+    if ((p = parse_number(p, end, idxi)) == nullptr || (p = parse_number(p, end, idxj)) == nullptr) {
+        return MtxLine::Malformed;
+    }
+    if constexpr (ParseValue) {
+        int ival;
+        switch (field) {
+            case MtxField::Real:
+            case MtxField::Complex:
+                if (parse_number(p, end, fval) == nullptr) {  // imaginary part is dropped
+                    return MtxLine::Malformed;
+                }
+                break;
+            case MtxField::Integer:
+                if (parse_number(p, end, ival) == nullptr) {
+                    return MtxLine::Malformed;
+                }
+                fval = ival;
+                break;
+            case MtxField::Pattern:
+                fval = 1.0;
+                break;
+        }
+    }
+    return MtxLine::Entry;
+}
+
+// 1-based line of `p` in a file starting at `begin` (error messages only)
+inline int64_t line_number(const char* begin, const char* p)
+{
+    return 1 + std::count(begin, p, '\n');
+}
+
+// Parallel Matrix Market reader.
+// The file is mapped and cut into chunks at line boundaries. A first pass builds one row histogram per
+// chunk, a prefix over (row, chunk) gives every chunk its own write cursor in each row, and a second pass
+// scatters the entries. Entries therefore keep their file order within a row, which makes the result
+// identical to read_from_mtx, including the symmetric expansion.
+template<class CsrMatrix>
+int read_from_mtx_parallel(CsrMatrix& matrix, std::string input)
+{
+    using IndexType = typename CsrMatrix::index_type;
+    using ValueType = typename CsrMatrix::value_type;
+
+    int         nrow, ncol, nnz_mtx_report;
+    MM_typecode matcode;
+    FILE*       f;
+
+    if ((f = fopen(input.c_str(), "r")) == NULL)
+        return -1;
+
+    if (mm_read_banner(f, &matcode) != 0) {
+        printf("Could not process Matrix Market banner.\n");
+        fclose(f);
+        return -2;
+    }
+    if (mm_read_mtx_crd_size(f, &nrow, &ncol, &nnz_mtx_report) != 0) {
+        fclose(f);
+        return -4;
+    }
+    const long data_offset = ftell(f);
+    fclose(f);
+
+    MtxField field = MtxField::Pattern;
+    if (mm_is_real(matcode)) {
+        field = MtxField::Real;
+    }
+    else if (mm_is_complex(matcode)) {
+        field = MtxField::Complex;
+    }
+    else if (mm_is_integer(matcode)) {
+        field = MtxField::Integer;
+    }
+    const bool symmetric = mm_is_symmetric(matcode) || mm_is_hermitian(matcode);
+
+    MappedFile file(input, MmapHint::WillNeed);
+    if (!file.is_open()) {
+        return -1;
+    }
+    const char* begin = file.data() + data_offset;
+    const char* end   = file.data() + file.size();
+
+    // one histogram of nrow counters per chunk: keep their total in the order of nnz
+    const int64_t entries_per_row = std::max<int64_t>(1, int64_t(nnz_mtx_report) / std::max(nrow, 1));
+    const int     num_chunks      = std::clamp<int64_t>(4 * entries_per_row, 1, omp_get_max_threads());
+    const auto    chunks          = split_lines(begin, end, num_chunks);
+
+    HostVector<IndexType>        counts(size_t(num_chunks) * nrow);
+    thrust::host_vector<int64_t> chunk_entries(num_chunks, 0);
+    bool                         in_range  = true;
+    int64_t                      malformed = end - begin;  // offset of the first line that does not parse
+
+    auto report_malformed = [&] {
+        if (malformed == end - begin) {
+            return false;
+        }
+        printf("Malformed Matrix Market entry at line %lld.\n", (long long)line_number(file.data(), begin + malformed));
+        return true;
+    };
+
+    // pass 1: per-chunk row histograms, zeroed (first touched) by the thread that fills them
+#pragma omp parallel for schedule(static, 1) reduction(&& : in_range) reduction(min : malformed)
+    for (int c = 0; c < num_chunks; c++) {
+        IndexType* count   = counts.data() + size_t(c) * nrow;
+        int64_t    entries = 0;
+        double     fval;
+        std::fill_n(count, nrow, IndexType(0));
+        for (const char* p = chunks[c]; p < chunks[c + 1]; p = next_line(p, chunks[c + 1])) {
+            int           idxi, idxj;
+            const MtxLine line = parse_mtx_entry<false>(p, chunks[c + 1], field, idxi, idxj, fval);
+            if (line != MtxLine::Entry) {
+                malformed = line == MtxLine::Malformed ? std::min<int64_t>(malformed, p - begin) : malformed;
+                continue;
+            }
+            idxi--;
+            idxj--;
+            if (idxi < 0 || idxi >= nrow || idxj < 0 || idxj >= ncol) {
+                in_range = false;
+                continue;
+            }
+            count[idxi]++;
+            if (symmetric && idxi != idxj) {
+                count[idxj]++;
+            }
+            entries++;
+        }
+        chunk_entries[c] = entries;
+    }
+
+    if (report_malformed()) {
+        return -5;
+    }
+    const int64_t num_entries = thrust::reduce(chunk_entries.begin(), chunk_entries.end(), int64_t(0));
+    if (!in_range || num_entries != nnz_mtx_report) {
+        printf("Matrix Market entries do not match the reported size.\n");
+        return -5;
+    }
+
+    // per row: exclusive prefix over chunks (write cursors), total into row_ptr
+    HostVector<IndexType> row_ptr(nrow + 1);
+    row_ptr[nrow] = 0;
+#pragma omp parallel for schedule(static)
+    for (int r = 0; r < nrow; r++) {
+        IndexType running = 0;
+        for (int c = 0; c < num_chunks; c++) {
+            const IndexType tmp          = counts[size_t(c) * nrow + r];
+            counts[size_t(c) * nrow + r] = running;
+            running += tmp;
+        }
+        row_ptr[r] = running;
+    }
+    thrust::exclusive_scan(thrust::host, row_ptr.begin(), row_ptr.end(), row_ptr.begin());
+
+    const IndexType       nnz = row_ptr[nrow];
+    HostVector<IndexType> col_idx(nnz);
+    HostVector<ValueType> values(nnz);
+
+    // pass 2: scatter in file order within every (row, chunk) slot; the values are parsed only here
+#pragma omp parallel for schedule(static, 1) reduction(min : malformed)
+    for (int c = 0; c < num_chunks; c++) {
+        IndexType* cursor = counts.data() + size_t(c) * nrow;
+        for (const char* p = chunks[c]; p < chunks[c + 1]; p = next_line(p, chunks[c + 1])) {
+            int           idxi, idxj;
+            double        fval = 0.0;
+            const MtxLine line = parse_mtx_entry<true>(p, chunks[c + 1], field, idxi, idxj, fval);
+            if (line != MtxLine::Entry) {
+                malformed = line == MtxLine::Malformed ? std::min<int64_t>(malformed, p - begin) : malformed;
+                continue;
+            }
+            idxi--;
+            idxj--;
+
+            IndexType offset = row_ptr[idxi] + cursor[idxi]++;
+            col_idx[offset]  = idxj;
+            values[offset]   = fval;
+            if (symmetric && idxi != idxj) {
+                offset          = row_ptr[idxj] + cursor[idxj]++;
+                col_idx[offset] = idxi;
+                values[offset]  = fval;
+            }
+        }
+    }
+
+    if (report_malformed()) {
+        return -5;
+    }
+
+    matrix.num_rows    = nrow;
+    matrix.num_cols    = ncol;
+    matrix.num_entries = nnz;
+
+    matrix.row_pointers   = std::move(row_ptr);
+    matrix.column_indices = std::move(col_idx);
+    matrix.values         = std::move(values);
+
+    return 0;
+}
+
 bool inline string_end_with(std::string base, std::string postfix)
 {
     // std::regex  string_end(".*" + postfix + "$");
@@ -218,144 +429,234 @@ struct larger_than_threshold {
     }
 };
 
+// Read-only view of a binary `.csr` file (`nrow nnz row_ptr[] col_idx[]`).
+// `row_pointers` and `column_indices` point straight into the mapped file pages.
+// The layout does not store the column count: it is max(nrow, largest column index + 1), so square
+// matrices stay square even if their last columns are empty (use `.gcsr` or `.mtx` for tall matrices).
+template<typename IndexType>
+struct MappedCsr {
+    MappedFile file;
+
+    IndexType num_rows{0};
+    IndexType num_cols{0};
+    IndexType num_entries{0};
+
+    const IndexType* row_pointers{nullptr};
+    const IndexType* column_indices{nullptr};
+};
+
+template<typename IndexType>
+bool map_csr_file(MappedCsr<IndexType>& view, const std::string& filename, MmapHint hint = MmapHint::Sequential)
+{
+    if (!view.file.open(filename, hint)) {
+        return false;
+    }
+    if (view.file.size() < 2 * sizeof(IndexType)) {
+        return false;
+    }
+
+    const IndexType* header = view.file.template as<IndexType>(0);
+    view.num_rows           = header[0];
+    view.num_entries        = header[1];
+
+    const size_t rowptr_offset = 2 * sizeof(IndexType);
+    const size_t colidx_offset = rowptr_offset + (size_t(view.num_rows) + 1) * sizeof(IndexType);
+    if (view.file.size() < colidx_offset + size_t(view.num_entries) * sizeof(IndexType)) {
+        return false;
+    }
+
+    view.row_pointers   = view.file.template as<IndexType>(rowptr_offset);
+    view.column_indices = view.file.template as<IndexType>(colidx_offset);
+
+    int64_t          max_col = -1;
+    const IndexType* cols    = view.column_indices;
+#pragma omp parallel for schedule(static) reduction(max : max_col)
+    for (int64_t j = 0; j < int64_t(view.num_entries); j++) {
+        max_col = std::max<int64_t>(max_col, cols[j]);
+    }
+    view.num_cols = std::max<int64_t>(view.num_rows, max_col + 1);
+    return true;
+}
+
 template<class CsrMatrix>
-void read_from_csr(CsrMatrix& matrix, const std::string& filename)
+bool read_from_csr(CsrMatrix& matrix, const std::string& filename, MmapHint hint = MmapHint::Sequential)
 {
     using IndexType = typename CsrMatrix::index_type;
-    std::ifstream csr_file;
-    csr_file.open(filename, std::ios::binary);
-    if (!csr_file.is_open()) {
+
+    MappedCsr<IndexType> view;
+    if (!map_csr_file(view, filename, hint)) {
         std::cout << "cannot open csr file!" << std::endl;
-        std::exit(1);
+        return false;
     }
-    IndexType nrow;
-    IndexType nnz;
-    csr_file.read(reinterpret_cast<char*>(&nrow), sizeof(IndexType));
-    csr_file.read(reinterpret_cast<char*>(&nnz), sizeof(IndexType));
+    const auto nrow = view.num_rows;
+    const auto nnz  = view.num_entries;
 
-    thrust::host_vector<IndexType> row_ptr(nrow + 1);
-    thrust::host_vector<IndexType> col_idx(nnz);
+    ASSERT(view.row_pointers[nrow] == nnz);
 
-    csr_file.read(reinterpret_cast<char*>(row_ptr.data()), (nrow + 1) * sizeof(int));
-    csr_file.read(reinterpret_cast<char*>(col_idx.data()), nnz * sizeof(IndexType));
-
-    ASSERT(row_ptr[nrow] == nnz);
-
-    csr_file.close();
-    matrix.resize(nrow, nrow, nnz);
-    matrix.row_pointers   = row_ptr;
-    matrix.column_indices = col_idx;
+    // copy once from the mapped pages into the matrix (host or device)
+    matrix.num_rows    = nrow;
+    matrix.num_cols    = view.num_cols;
+    matrix.num_entries = nnz;
+    matrix.row_pointers.assign(view.row_pointers, view.row_pointers + nrow + 1);
+    matrix.column_indices.assign(view.column_indices, view.column_indices + nnz);
+    matrix.values.resize(nnz);
     thrust::fill(matrix.values.begin(), matrix.values.end(), 1.0);
+    return true;
 }
 
+struct EdgeListOptions {
+    bool symmetrize  = false;  // also insert (v, u) for every edge (u, v)
+    bool deduplicate = true;   // keep a single copy of repeated edges (implies sort)
+    bool sort        = true;   // sort column indices within each row
+};
+
+// Parallel reader for whitespace separated `u v` edge lists (SNAP style, `#`/`%` comment lines).
+// The matrix has max(u) + 1 rows and max(v) + 1 columns, or is square with max(u, v) + 1 rows when
+// `symmetrize` is set; header comments are not trusted for sizes.
+//   1. the mapped file is parsed chunk-wise into per-chunk edge buffers
+//   2. per-group row histograms + prefix give every group its own cursor per row (two-pass CSR build)
+//   3. rows are sorted and deduplicated independently (segmented_sort_rows)
 template<typename CsrMatrix>
-bool read_from_edgelist(CsrMatrix& mat, const std::string& filename)
+bool read_from_edgelist(CsrMatrix&             mat,
+                        const std::string&     filename,
+                        const EdgeListOptions& options = EdgeListOptions())
 {
-    std::ifstream input(filename);
-    if (!input.is_open()) {
+    using IndexType = typename CsrMatrix::index_type;
+
+    MappedFile file(filename, MmapHint::WillNeed);
+    if (!file.is_open()) {
         std::cout << "Cannot open the input file!" << std::endl;
         return false;
     }
 
-    // First pass: count number of rows and entries
-    std::string                              line;
-    int                                      max_row = -1;
-    int                                      max_col = -1;
-    thrust::host_vector<std::pair<int, int>> edges;
-
-    int num_rows    = 0;
-    int num_entries = 0;
-    // First pass: read header and count nodes/edges
-    while (std::getline(input, line)) {
-        if (line.empty())
-            continue;
-
-        if (line[0] == '#') {
-            // Check if this is the header line containing node/edge counts
-            if (line.find("Nodes:") != std::string::npos && line.find("Edges:") != std::string::npos) {
-                int                num_nodes, num_edges;
-                std::istringstream iss(line.substr(2));  // Skip "# "
-                std::string        dummy;
-                if (iss >> dummy >> num_nodes >> dummy >> num_edges) {
-                    edges.reserve(num_edges);
-                }
-
-                printf("num_nodes: %d, num_edges: %d\n", num_nodes, num_edges);
-
-                num_rows    = num_nodes;
-                num_entries = num_edges;
+    const int  num_chunks = omp_get_max_threads();
+    const auto chunks     = split_lines(file.data(), file.data() + file.size(), num_chunks);
+
+    std::vector<HostVector<IndexType>> sources(num_chunks);
+    std::vector<HostVector<IndexType>> targets(num_chunks);
+    int64_t                            max_u = -1;
+    int64_t                            max_v = -1;
+
+#pragma omp parallel for schedule(static, 1) reduction(max : max_u, max_v)
+    for (int c = 0; c < num_chunks; c++) {
+        const char* end = chunks[c + 1];
+        for (const char* p = chunks[c]; p < end; p = next_line(p, end)) {
+            const char* q = skip_blanks(p, end);
+            int64_t     u, v;
+            if (q == end || *q == '#' || *q == '%') {
+                continue;
             }
-            continue;
-        }
-
-        // Process edge line
-        int                row, col;
-        std::istringstream iss(line);
-        if (!(iss >> row >> col)) {
-            continue;  // Skip malformed lines
+            if ((q = parse_number(q, end, u)) == nullptr || parse_number(q, end, v) == nullptr || u < 0 || v < 0) {
+                continue;  // Skip malformed lines
+            }
+            sources[c].push_back(u);
+            targets[c].push_back(v);
+            max_u = std::max(max_u, u);
+            max_v = std::max(max_v, v);
         }
-
-        max_row = std::max(max_row, row);
-        max_col = std::max(max_col, col);
-        edges.push_back(std::make_pair(row, col));
     }
-    printf("edges are paired\n");
-    // int num_rows    = max_row + 1;
-    // int num_entries = edges.size();
 
-    // Initialize CSR arrays
-    thrust::host_vector<int> row_ptr(num_rows + 1, 0);
-    thrust::host_vector<int> col_idx(num_entries);
+    const int64_t num_rows = (options.symmetrize ? std::max(max_u, max_v) : max_u) + 1;
+    const int64_t num_cols = (options.symmetrize ? std::max(max_u, max_v) : max_v) + 1;
 
-    printf("count entries per row\n");
-    // Count entries per row
-    for (const auto& edge : edges) {
-        row_ptr[edge.first + 1]++;
-    }
+    HostVector<IndexType> row_ptr, col_idx;
+    edge_chunks_to_csr(sources, targets, num_rows, options.symmetrize, row_ptr, col_idx);
 
-    printf("cumulative sum to get row pointers\n");
-    // Cumulative sum to get row pointers
-    for (int i = 1; i <= num_rows; i++) {
-        row_ptr[i] += row_ptr[i - 1];
+    // Sort (and deduplicate) column indices within each row
+    if (options.sort || options.deduplicate) {
+        HostVector<float>* no_values = nullptr;
+        segmented_sort_rows(row_ptr, col_idx, no_values, options.deduplicate);
     }
 
-    // Second pass: fill column indices
-    printf("fill column indices\n");
-    thrust::host_vector<int> current_pos = row_ptr;  // Copy to track current position for each row
-    for (const auto& edge : edges) {
-        int row                     = edge.first;
-        col_idx[current_pos[row]++] = edge.second;
-    }
-
-    // Sort column indices within each row
-    // #pragma omp parallel for
-    //     for (int i = 0; i < num_rows; i++) {
-    //         std::sort(col_idx.begin() + row_ptr[i], col_idx.begin() + row_ptr[i + 1]);
-    //     }
-
     // Update matrix properties
-    mat.resize(num_rows, num_rows, num_entries);
-    mat.row_pointers   = row_ptr;
-    mat.column_indices = col_idx;
+    const IndexType nnz = row_ptr[num_rows];
+    mat.num_rows        = num_rows;
+    mat.num_cols        = num_cols;
+    mat.num_entries     = nnz;
+    mat.row_pointers    = std::move(row_ptr);
+    mat.column_indices  = std::move(col_idx);
+    mat.values.resize(nnz);
+    thrust::fill(mat.values.begin(), mat.values.end(), 1.0);
 
     return true;
 }
 
-template<class CsrMatrix>
-void read_matrix_file(CsrMatrix& d_csr_A, std::string input)
+bool inline is_edgelist_file(const std::string& filename)
+{
+    return string_end_with(filename, ".txt") || string_end_with(filename, ".el") || string_end_with(filename, ".edges");
+}
+
+// Read a permutation written by write_permutation_file (`.garr` or `.txt`)
+template<typename Vector>
+bool read_permutation_file(Vector& permutation, const std::string& input)
+{
+    if (string_end_with(input, ".garr")) {
+        return read_from_garray(permutation, input);
+    }
+    else if (string_end_with(input, ".txt")) {
+        MappedFile file(input, MmapHint::Sequential);
+        if (!file.is_open()) {
+            std::cout << "Cannot open the input file!" << std::endl;
+            return false;
+        }
+        thrust::host_vector<typename Vector::value_type> perm;
+        const char*                                      end = file.data() + file.size();
+        for (const char* p = file.data(); p < end; p = next_line(p, end)) {
+            typename Vector::value_type id;
+            if (parse_number(p, end, id) != nullptr) {
+                perm.push_back(id);
+            }
+        }
+        permutation = perm;
+        return true;
+    }
+    printf("permutation file format is not supported\n");
+    return false;
+}
+
+// Read any supported format; returns false (after printing why) instead of exiting
+// `permutation` receives the permutation embedded in a `.gcsr` file (left empty when there is none)
+template<class CsrMatrix, typename Vector = thrust::host_vector<int>>
+bool try_read_matrix_file(CsrMatrix& d_csr_A, std::string input, Vector* permutation = nullptr)
 {
     if (input.empty()) {
         printf("input file is NOT specified!\n");
-        std::exit(1);
+        return false;
     }
+    TraceScope scope("io.read");
     if (string_end_with(input, ".mtx")) {
-        read_from_mtx(d_csr_A, input);
+        if (read_from_mtx_parallel(d_csr_A, input) != 0) {
+            printf("cannot read mtx file!\n");
+            return false;
+        }
     }
     else if (string_end_with(input, ".csr")) {
-        read_from_csr(d_csr_A, input);
+        if (!read_from_csr(d_csr_A, input)) {
+            return false;
+        }
+    }
+    else if (is_edgelist_file(input)) {
+        if (!read_from_edgelist(d_csr_A, input)) {
+            return false;
+        }
+    }
+    else if (string_end_with(input, ".gcsr")) {
+        if (!read_from_gcsr(d_csr_A, input, permutation)) {
+            return false;
+        }
     }
     else {
         printf("input file is NOT supported!\n");
+        return false;
+    }
+    scope.counter("nnz", d_csr_A.num_entries);
+    return true;
+}
+
+template<class CsrMatrix, typename Vector = thrust::host_vector<int>>
+void read_matrix_file(CsrMatrix& d_csr_A, std::string input, Vector* permutation = nullptr)
+{
+    if (!try_read_matrix_file(d_csr_A, input, permutation)) {
         std::exit(1);
     }
 }
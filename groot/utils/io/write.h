@@ -6,6 +6,7 @@
 
 namespace groot {
 
+// The `.csr` layout has no column count; readers infer it (see MappedCsr)
 template<typename CsrMatrix>
 bool write_into_csr(const CsrMatrix& mat, std::string output)
 {
@@ -34,6 +35,74 @@ bool write_into_csr(const CsrMatrix& mat, std::string output)
 
 
 
+// Stream a blocked view (e.g. PermutedCsrView) into the `.csr` layout without materializing it:
+// column blocks are appended as they are produced, row pointers and nnz are filled in at the end.
+template<typename View>
+bool write_blocks_into_csr(const View& view, std::string output, typename View::index_type block_rows = 1 << 16)
+{
+    using IndexType = typename View::index_type;
+
+    FILE* fp = fopen(output.c_str(), "wb");
+    if (fp == NULL) {
+        fputs("file error", stderr);
+        return false;
+    }
+    std::cout << "writing to " << output << std::endl;
+
+    const IndexType                nrow = view.num_rows;
+    IndexType                      nnz  = 0;
+    thrust::host_vector<IndexType> row_ptr(nrow + 1, 0);
+
+    // every write is checked; after the first failure the remaining blocks are only counted
+    bool ok = fseek(fp, (2 + size_t(nrow) + 1) * sizeof(IndexType), SEEK_SET) == 0;
+    view.for_each_block(block_rows, [&](IndexType first, const auto& block) {
+        for (IndexType r = 0; r < block.num_rows; r++) {
+            row_ptr[first + r + 1] = nnz + block.row_pointers[r + 1];
+        }
+        ok = ok
+             && (block.num_entries == 0
+                 || fwrite(block.column_indices.data(), sizeof(IndexType), block.num_entries, fp)
+                        == size_t(block.num_entries));
+        nnz += block.num_entries;
+    });
+
+    ok = ok && fseek(fp, 0, SEEK_SET) == 0 && fwrite(&nrow, sizeof(IndexType), 1, fp) == 1
+         && fwrite(&nnz, sizeof(IndexType), 1, fp) == 1
+         && fwrite(row_ptr.data(), sizeof(IndexType), nrow + 1, fp) == size_t(nrow) + 1;
+
+    if (fclose(fp) != 0 || !ok) {
+        printf("cannot write %s\n", output.c_str());
+        std::remove(output.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Write only the permutation (new_ids[old_row] = new_row): `.garr` (binary) or `.txt` (one id per line)
+template<typename Vector>
+bool write_permutation_file(const Vector& permutation, std::string output)
+{
+    if (string_end_with(output, ".garr")) {
+        std::cout << "writing permutation to " << output << std::endl;
+        return write_into_garray(permutation, output);
+    }
+    else if (string_end_with(output, ".txt")) {
+        thrust::host_vector<typename Vector::value_type> perm = permutation;
+        std::ofstream                                     out(output);
+        if (!out.is_open()) {
+            std::cout << "cannot open the output file!" << std::endl;
+            return false;
+        }
+        std::cout << "writing permutation to " << output << std::endl;
+        for (const auto id : perm) {
+            out << id << '\n';
+        }
+        return bool(out);
+    }
+    printf("permutation file format is not supported\n");
+    return false;
+}
+
 template<typename CsrMatrix>
 bool write_into_mtx(const CsrMatrix& mat, std::string out)
 {
@@ -43,16 +112,18 @@ bool write_into_mtx(const CsrMatrix& mat, std::string out)
         return false;
     }
     auto                     nrow    = mat.num_rows;
+    auto                     ncol    = mat.num_cols;
     auto                     nnz     = mat.num_entries;
     thrust::host_vector<int> row_ptr = mat.row_pointers;
     thrust::host_vector<int> col_idx = mat.column_indices;
     ASSERT(row_ptr[nrow] == nnz && "row_ptr[nrow] != nnz");
 
+    // Matrix Market indices are 1-based
     output << "%%MatrixMarket matrix coordinate pattern general\n";
-    output << nrow << " " << nrow << " " << nnz << '\n';
+    output << nrow << " " << ncol << " " << nnz << '\n';
     for (unsigned i = 0; i < nrow; i++) {
         for (unsigned j = row_ptr[i]; j < row_ptr[i + 1]; j++) {
-            output << i << " " << col_idx[j] << '\n';
+            output << i + 1 << " " << col_idx[j] + 1 << '\n';
         }
     }
     output.close();
@@ -60,22 +131,41 @@ bool write_into_mtx(const CsrMatrix& mat, std::string out)
     return true;
 }
 
-template<typename CsrMatrix>
-void write_matrix_file(CsrMatrix& d_csr_A, std::string output)
+// `permutation` is embedded into `.gcsr` outputs and ignored by the other formats.
+// Returns false (after printing why) instead of exiting; an empty `output` writes nothing.
+template<typename CsrMatrix, typename Vector = thrust::host_vector<int>>
+bool try_write_matrix_file(const CsrMatrix& d_csr_A, std::string output, const Vector* permutation = nullptr)
 {
     if (output.empty()) {
-        return;  // nothing happens
+        return true;  // nothing happens
     }
-    else if (string_end_with(output, ".csr")) {
+    TraceScope scope("io.write");
+    scope.counter("nnz", d_csr_A.num_entries);
+    if (string_end_with(output, ".csr")) {
         std::cout << "converting to CSR format" << std::endl;
-        write_into_csr(d_csr_A, output);
+        return write_into_csr(d_csr_A, output);
+    }
+    else if (string_end_with(output, ".gcsr")) {
+        std::cout << "converting to GCSR format" << std::endl;
+        std::cout << "writing to " << output << std::endl;
+        if (!write_into_gcsr(d_csr_A, output, permutation)) {
+            std::cout << "cannot write " << output << std::endl;
+            return false;
+        }
+        return true;
     }
     else if (string_end_with(output, ".mtx")) {
         std::cout << "converting to MTX format" << std::endl;
-        write_into_mtx(d_csr_A, output);
+        return write_into_mtx(d_csr_A, output);
     }
-    else {
-        printf("file format is not supported\n");
+    printf("file format is not supported\n");
+    return false;
+}
+
+template<typename CsrMatrix, typename Vector = thrust::host_vector<int>>
+void write_matrix_file(CsrMatrix& d_csr_A, std::string output, const Vector* permutation = nullptr)
+{
+    if (!try_write_matrix_file(d_csr_A, output, permutation)) {
         std::exit(1);
     }
 }
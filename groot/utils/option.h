@@ -1,7 +1,13 @@
 
 #pragma once
 #include <getopt.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
 #include <string>
+#include <utility>
 
 namespace groot {
 
@@ -23,12 +29,77 @@ struct Config {
     std::string input_file;
     std::string output_file;
     ReorderAlgo reorder         = ReorderAlgo::Groot;
+    unsigned    knn_k           = 200;
+    unsigned    knn_l           = 300;
+    KnnMetric   knn_metric      = KnnMetric::Hamming;
+    std::string report_file;       // JSON telemetry report
+    std::string trace_file;        // Chrome trace of the phases
+    bool        perf_counters = false;
+    std::string cache_dir;         // KNN graph / permutation cache
+    bool        checkpoints = false;  // also checkpoint clean edges and MST forest in cache_dir
+    std::string permutation_file;  // write new_ids only (.garr or .txt)
+    std::string batch_file;        // manifest of `input [output] [permutation]` jobs
+    int         batch_workers = 0;
+    bool        deterministic = false;  // reproducible permutation, seeded KNN
+    unsigned    seed          = 1984;
+    std::string incremental_dir;  // state of the incremental reorderer (updated in place)
+    double      time_budget_ms    = 0;      // deadline of the reordering (0: none)
+    bool        original_fallback = false;  // order what the budget cut off by row id instead of by degree
+    std::string column_permutation_file;    // order columns independently (two-sided) and write their permutation
+    int         tile_rows = 16;             // tensor-core tile of the tile report and the column panels
+    int         tile_cols = 8;              // also the column block width of the `blocks` KNN metric
 };
 
 std::string option_hints =
     "              [-i input_file]\n"
     "              [-o output_file]\n"
-    "              [-r reorder_algorithm (0: none, 1: groot)]\n";
+    "              [-p permutation_file (.garr or .txt; without -o the matrix is not rebuilt)]\n"
+    "              [-q column_permutation_file (order columns separately: two-sided P A Q)]\n"
+    "              [-m tile_rows,tile_cols (default: 16,8)]\n"
+    "              [-r reorder_algorithm (0: none, 1: groot)]\n"
+    "              [-b batch_manifest (one `input [output] [permutation]` per line)]\n"
+    "              [-w batch_small_workers (default: threads / 4)]\n"
+    "              [-k knn_neighbors (default: 200)]\n"
+    "              [-l knn_pool_size (default: 300)]\n"
+    "              [-M knn_metric (hamming (default), jaccard, overlap, weighted-hamming, cosine, blocks)]\n"
+    "              [-D seed (deterministic mode: same permutation for any thread count)]\n"
+    "              [-T time_budget_ms (cut KNN/MST/DFS short to finish in time)]\n"
+    "              [-F budget_fallback (degree (default) or original)]\n"
+    "              [-c cache_dir]\n"
+    "              [-C (checkpoint clean edges and the MST forest in cache_dir, resume from them)]\n"
+    "              [-U incremental_state_dir (update the last permutation for the rows that changed)]\n"
+    "              [-j json_report]\n"
+    "              [-t chrome_trace]\n"
+    "              [-P (sample hardware performance counters per phase)]\n"
+    "              [-N numa_policy (first-touch (default), interleave, bind:<node>, none)]\n"
+    "              [-H (back the scratch arena with MAP_HUGETLB pages when reserved)]\n";
+
+// A whole decimal number that fits an unsigned (std::stoul takes "12abc" and "-1")
+inline bool parse_seed(const char* text, unsigned& seed)
+{
+    char* end = nullptr;
+    errno     = 0;
+    const unsigned long value = strtoul(text, &end, 10);
+    if (text[0] == '-' || end == text || *end != '\0' || errno == ERANGE
+        || value > std::numeric_limits<unsigned>::max()) {
+        return false;
+    }
+    seed = unsigned(value);
+    return true;
+}
+
+// A finite, non-negative number (std::stod throws on "abc" and takes "-5", which turned the budget off)
+inline bool parse_time_budget(const char* text, double& budget_ms)
+{
+    char* end = nullptr;
+    errno     = 0;
+    const double value = strtod(text, &end);
+    if (end == text || *end != '\0' || errno == ERANGE || !std::isfinite(value) || value < 0) {
+        return false;
+    }
+    budget_ms = value;
+    return true;
+}
 
 auto program_options(int argc, char* argv[])
 {
@@ -38,7 +109,7 @@ auto program_options(int argc, char* argv[])
         printf("Usage: %s ... \n%s", argv[0], option_hints.c_str());
         std::exit(EXIT_FAILURE);
     }
-    while ((opt = getopt(argc, argv, "e:r:i:c:o:s:b:v:")) != -1) {
+    while ((opt = getopt(argc, argv, "e:r:i:c:o:p:q:m:s:b:v:k:l:M:j:t:w:D:U:T:F:N:CHP")) != -1) {
         switch (opt) {
             case 'i':
                 config.input_file = optarg;
@@ -46,25 +117,171 @@ auto program_options(int argc, char* argv[])
             case 'o':
                 config.output_file = optarg;
                 break;
+            case 'b':
+                config.batch_file = optarg;
+                break;
+            case 'w':
+                config.batch_workers = std::stoi(optarg);
+                break;
+            case 'p':
+                config.permutation_file = optarg;
+                break;
+            case 'q':
+                config.column_permutation_file = optarg;
+                break;
+            case 'm':
+                if (sscanf(optarg, "%d,%d", &config.tile_rows, &config.tile_cols) != 2 || config.tile_rows < 1
+                    || config.tile_cols < 1) {
+                    printf("tile shape must be rows,cols: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
             case 'r':
                 config.reorder = static_cast<ReorderAlgo>(std::stoi(optarg));
                 break;
+            case 'k':
+                config.knn_k = std::stoi(optarg);
+                break;
+            case 'l':
+                config.knn_l = std::stoi(optarg);
+                break;
+            case 'M':
+                if (!parse_knn_metric(optarg, config.knn_metric)) {
+                    printf("unknown KNN metric: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'c':
+                config.cache_dir = optarg;
+                break;
+            case 'C':
+                config.checkpoints = true;
+                break;
+            case 'D':
+                if (!parse_seed(optarg, config.seed)) {
+                    printf("seed must be an unsigned integer: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                config.deterministic = true;
+                break;
+            case 'T':
+                if (!parse_time_budget(optarg, config.time_budget_ms)) {
+                    printf("time budget must be a non-negative number of milliseconds: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'F':
+                if (std::string(optarg) != "degree" && std::string(optarg) != "original") {
+                    printf("unknown budget fallback: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                config.original_fallback = std::string(optarg) == "original";
+                break;
+            case 'U':
+                config.incremental_dir = optarg;
+                break;
+            case 'j':
+                config.report_file = optarg;
+                break;
+            case 't':
+                config.trace_file = optarg;
+                break;
+            case 'P':
+                config.perf_counters = true;
+                break;
+            case 'H':
+                arena_settings().hugetlb = true;
+                break;
+            case 'N':
+                if (!parse_numa_policy(optarg, numa_settings())) {
+                    printf("unknown NUMA policy: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
             default:
                 printf("Usage: %s ... \n%s", argv[0], option_hints.c_str());
                 exit(EXIT_FAILURE);
         }
     }
 
+    // a budget cuts phases short by the wall clock, which deterministic mode promises not to depend on
+    if (config.deterministic && config.time_budget_ms > 0) {
+        printf("-D and -T cannot be combined: a time budget makes the permutation depend on timing\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // the incremental state keeps the full KNN graph and forest: it never reads the cache or cuts phases short
+    if (!config.incremental_dir.empty() && (config.time_budget_ms > 0 || !config.cache_dir.empty())) {
+        printf("-U cannot be combined with -T or -c: incremental runs always build their full state\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // batch jobs take their paths from the manifest and run concurrently: the per-run outputs have no home there
+    if (!config.batch_file.empty()) {
+        const std::pair<bool, const char*> per_run[] = {
+            {!config.input_file.empty(), "-i"},
+            {!config.output_file.empty(), "-o"},
+            {!config.permutation_file.empty(), "-p"},
+            {!config.column_permutation_file.empty(), "-q"},
+            {!config.incremental_dir.empty(), "-U"},
+            {!config.report_file.empty(), "-j"},
+            {!config.trace_file.empty(), "-t"},
+            {config.perf_counters, "-P"},
+            {config.reorder == ReorderAlgo::None, "-r 0"},
+        };
+        for (const auto& [given, flag] : per_run) {
+            if (given) {
+                printf("%s is not supported with a batch manifest (-b)\n", flag);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
     printf("--------experimental setting--------\n");
     if (!config.input_file.empty()) {
         printf("input path: %s\n", config.input_file.c_str());
     }
+    if (!config.batch_file.empty()) {
+        printf("batch manifest: %s\n", config.batch_file.c_str());
+    }
     if (config.reorder != ReorderAlgo::None) {
         printf("reorder algorithm: %s\n", reorder_algo_to_string(config.reorder));
+        printf("knn K: %u, L: %u, metric: %s\n", config.knn_k, config.knn_l, knn_metric_to_string(config.knn_metric));
+        if (config.deterministic) {
+            printf("deterministic mode, seed: %u\n", config.seed);
+        }
+        if (!config.cache_dir.empty()) {
+            printf("cache directory: %s%s\n", config.cache_dir.c_str(), config.checkpoints ? " (checkpoints)" : "");
+        }
+        else if (config.checkpoints) {
+            printf("checkpoints need a cache directory (-c)\n");
+            exit(EXIT_FAILURE);
+        }
+        if (config.time_budget_ms > 0) {
+            printf("time budget (ms): %.2f, fallback: %s\n",
+                   config.time_budget_ms,
+                   config.original_fallback ? "original" : "degree");
+        }
+        if (!config.incremental_dir.empty()) {
+            printf("incremental state: %s\n", config.incremental_dir.c_str());
+        }
+        printf("tile shape: %dx%d\n", config.tile_rows, config.tile_cols);
     }
     if (!config.output_file.empty()) {
         printf("output path: %s\n", config.output_file.c_str());
     }
+    if (!config.permutation_file.empty()) {
+        printf("permutation path: %s\n", config.permutation_file.c_str());
+    }
+    if (!config.column_permutation_file.empty()) {
+        printf("column permutation path: %s\n", config.column_permutation_file.c_str());
+    }
+    if (!config.report_file.empty()) {
+        printf("report path: %s\n", config.report_file.c_str());
+    }
+    if (!config.trace_file.empty()) {
+        printf("trace path: %s\n", config.trace_file.c_str());
+    }
 
     return config;
 }
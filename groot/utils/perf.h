@@ -0,0 +1,270 @@
+#pragma once
+#include <omp.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace groot {
+
+// Hardware performance counters per OpenMP thread (Linux perf_event_open).
+//
+// Every thread of the OpenMP pool opens its own user-space-only counters (exclude_kernel), which is allowed
+// without root as long as /proc/sys/kernel/perf_event_paranoid <= 2. Events that cannot be opened (paranoid
+// level, virtual machines without a PMU, non-Linux systems) are marked invalid and reported as "n/a"; nothing
+// else changes. Counters run continuously once enabled: a phase is measured as the difference of two read()s.
+// The runtime is assumed to keep its thread pool, as libgomp and libomp do.
+
+enum PerfEvent { PerfCycles = 0, PerfInstructions, PerfLlcMisses, PerfDtlbMisses, PerfBranchMisses, NumPerfEvents };
+
+inline const char* perf_event_name(int event)
+{
+    switch (event) {
+        case PerfCycles:
+            return "cycles";
+        case PerfInstructions:
+            return "instructions";
+        case PerfLlcMisses:
+            return "llc_misses";
+        case PerfDtlbMisses:
+            return "dtlb_misses";
+        case PerfBranchMisses:
+            return "branch_misses";
+        default:
+            return "unknown";
+    }
+}
+
+struct PerfSample {
+    std::array<uint64_t, NumPerfEvents> values{};  // summed over threads, scaled for multiplexing
+    std::array<bool, NumPerfEvents>     valid{};
+    std::vector<uint64_t>               thread_cycles;  // per-thread cycles, to spot imbalance
+
+    bool any_valid() const
+    {
+        for (const bool v : valid) {
+            if (v) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    PerfSample operator-(const PerfSample& before) const
+    {
+        PerfSample diff = *this;
+        for (int e = 0; e < NumPerfEvents; e++) {
+            diff.valid[e]  = valid[e] && before.valid[e];
+            diff.values[e] = diff.valid[e] ? values[e] - before.values[e] : 0;
+        }
+        for (size_t t = 0; t < diff.thread_cycles.size() && t < before.thread_cycles.size(); t++) {
+            diff.thread_cycles[t] -= before.thread_cycles[t];
+        }
+        return diff;
+    }
+};
+
+class PerfCounters {
+public:
+    static PerfCounters& instance()
+    {
+        static PerfCounters counters;
+        return counters;
+    }
+
+    // Open the counters on every OpenMP thread; returns whether at least one event is available
+    bool enable()
+    {
+        if (active) {
+            return available();
+        }
+        active = true;
+#ifdef __linux__
+        const int num_threads = omp_get_max_threads();
+        fds.assign(num_threads, {});
+#pragma omp parallel num_threads(num_threads)
+        {
+            auto& fd = fds[omp_get_thread_num()];
+            for (int e = 0; e < NumPerfEvents; e++) {
+                fd[e] = open_event(e);
+            }
+        }
+#endif
+        if (!available()) {
+            printf("[perf] hardware counters are not available (check /proc/sys/kernel/perf_event_paranoid)\n");
+        }
+        return available();
+    }
+
+    bool enabled() const
+    {
+        return active;
+    }
+
+    bool available() const
+    {
+        for (const auto& fd : fds) {
+            for (const int f : fd) {
+                if (f >= 0) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    PerfSample read() const
+    {
+        PerfSample sample;
+        sample.thread_cycles.assign(fds.size(), 0);
+        for (int e = 0; e < NumPerfEvents; e++) {
+            sample.valid[e] = !fds.empty();
+            for (size_t t = 0; t < fds.size(); t++) {
+                uint64_t value;
+                if (!read_event(fds[t][e], value)) {
+                    sample.valid[e] = false;
+                    continue;
+                }
+                sample.values[e] += value;
+                if (e == PerfCycles) {
+                    sample.thread_cycles[t] = value;
+                }
+            }
+        }
+        return sample;
+    }
+
+    ~PerfCounters()
+    {
+#ifdef __linux__
+        for (const auto& fd : fds) {
+            for (const int f : fd) {
+                if (f >= 0) {
+                    ::close(f);
+                }
+            }
+        }
+#endif
+    }
+
+private:
+    PerfCounters() = default;
+
+#ifdef __linux__
+    static int open_event(int event)
+    {
+        perf_event_attr attr{};
+        attr.size           = sizeof(attr);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        const uint64_t read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        switch (event) {
+            case PerfCycles:
+                attr.type   = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case PerfInstructions:
+                attr.type   = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case PerfLlcMisses:
+                attr.type   = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_LL | read_miss;
+                break;
+            case PerfDtlbMisses:
+                attr.type   = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_DTLB | read_miss;
+                break;
+            case PerfBranchMisses:
+                attr.type   = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+            default:
+                return -1;
+        }
+        // pid = 0, cpu = -1: the calling thread on any CPU
+        return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+
+    static bool read_event(int fd, uint64_t& value)
+    {
+#ifdef __linux__
+        uint64_t data[3];  // value, time enabled, time running
+        if (fd < 0 || ::read(fd, data, sizeof(data)) != sizeof(data)) {
+            return false;
+        }
+        value = data[0];
+        if (data[2] > 0 && data[2] < data[1]) {
+            value = static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool                                        active{false};
+    std::vector<std::array<int, NumPerfEvents>> fds;
+};
+
+// Measures the counters between construction and sample()
+class PerfPhase {
+public:
+    PerfPhase()
+    {
+        if (PerfCounters::instance().enabled()) {
+            before = PerfCounters::instance().read();
+        }
+    }
+
+    PerfSample sample() const
+    {
+        return PerfCounters::instance().enabled() ? PerfCounters::instance().read() - before : PerfSample();
+    }
+
+private:
+    PerfSample before;
+};
+
+inline void print_perf_sample(const char* phase, const PerfSample& sample)
+{
+    if (!sample.any_valid()) {
+        return;
+    }
+    printf("[%s] perf:", phase);
+    for (int e = 0; e < NumPerfEvents; e++) {
+        if (sample.valid[e]) {
+            printf(" %s: %llu", perf_event_name(e), (unsigned long long)sample.values[e]);
+        }
+        else {
+            printf(" %s: n/a", perf_event_name(e));
+        }
+    }
+    if (sample.valid[PerfCycles] && sample.valid[PerfInstructions] && sample.values[PerfCycles] > 0) {
+        printf(", IPC: %.2f", double(sample.values[PerfInstructions]) / sample.values[PerfCycles]);
+    }
+    // busiest thread relative to the average: 1.0 means perfectly balanced
+    uint64_t max_cycles = 0, sum_cycles = 0;
+    for (const auto c : sample.thread_cycles) {
+        max_cycles = std::max(max_cycles, c);
+        sum_cycles += c;
+    }
+    if (sample.valid[PerfCycles] && sum_cycles > 0 && sample.thread_cycles.size() > 1) {
+        printf(", imbalance: %.2f", double(max_cycles) * sample.thread_cycles.size() / sum_cycles);
+    }
+    printf("\n");
+}
+
+}  // namespace groot
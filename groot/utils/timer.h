@@ -1,9 +1,15 @@
 #pragma once
+#ifndef GROOT_CPU_ONLY
 #include <cuda_runtime.h>
+#endif
+#include <algorithm>
 #include <chrono>
+#include <limits>
+#include <type_traits>
 
 namespace groot {
 
+#ifndef GROOT_CPU_ONLY
 class CUDATimer {
 public:
     CUDATimer() {
@@ -33,6 +39,7 @@ private:
     cudaEvent_t start_time;
     cudaEvent_t end_time;
 };
+#endif
 
 class CPUTimer {
 public:
@@ -50,4 +57,59 @@ private:
         end_time;
 };
 
+// Wall-clock budget started on construction; a budget of 0 never expires
+class Deadline {
+public:
+    Deadline() = default;
+
+    explicit Deadline(double budget_ms): active(budget_ms > 0), end_time(after(budget_ms)) {}
+
+    bool enabled() const { return active; }
+
+    double remaining_ms() const {
+        if (!active) {
+            return std::numeric_limits<double>::infinity();
+        }
+        const auto left = std::chrono::duration<double, std::milli>(end_time - std::chrono::steady_clock::now());
+        return std::max(0.0, left.count());
+    }
+
+    bool expired() const { return active && std::chrono::steady_clock::now() >= end_time; }
+
+    // Deadline after `fraction` of the time that is left (expired if this one is)
+    Deadline portion(double fraction) const {
+        Deadline part = *this;
+        if (active) {
+            part.end_time = after(remaining_ms() * fraction);
+        }
+        return part;
+    }
+
+private:
+    static std::chrono::steady_clock::time_point after(double ms) {
+        const auto budget = std::chrono::duration<double, std::milli>(std::min(ms, 1e12));  // no overflow
+        return std::chrono::steady_clock::now()
+               + std::chrono::duration_cast<std::chrono::steady_clock::duration>(budget);
+    }
+
+    bool                                  active = false;
+    std::chrono::steady_clock::time_point end_time;
+};
+
+// Timer matching where a matrix lives: CUDA events for device memory, wall clock otherwise
+template<typename MemorySpace>
+struct TimerTrait {
+    using type = CPUTimer;
+};
+
+#ifndef GROOT_CPU_ONLY
+template<>
+struct TimerTrait<device_memory> {
+    using type = CUDATimer;
+};
+#endif
+
+template<typename MemorySpace>
+using TimerType = typename TimerTrait<MemorySpace>::type;
+
 }  // namespace groot
\ No newline at end of file
@@ -0,0 +1,386 @@
+#pragma once
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace groot {
+
+// Scoped, nestable phase telemetry.
+//
+//   {
+//       TraceScope scope("mst");
+//       ...
+//       scope.counter("edges_examined", n);   // or Tracer::instance().add_counter(...) from callees
+//   }
+//
+// Every scope records wall time, process CPU time (all threads), the change of the resident set size, the
+// growth of the process peak RSS and the bytes allocated while it was open. The peak is a high-water mark:
+// a phase that stays under an earlier peak reports no peak growth even when its own footprint rose. Byte
+// counts need the allocation hooks: define GROOT_TRACE_ALLOCATIONS in exactly one translation unit before
+// including groot.h. Tracing is off until Tracer::enable() is called, and disabled scopes cost one branch.
+// When PerfCounters are enabled, every scope also gets the hardware counter deltas as "perf.<event>" counters.
+
+struct TraceEvent {
+    std::string name;
+    int         parent{-1};
+    int         depth{0};
+    double      start_ms{0};
+    double      wall_ms{0};
+    double      cpu_ms{0};
+    int64_t     rss_delta_kb{0};
+    int64_t     peak_rss_growth_kb{0};
+    uint64_t    bytes_allocated{0};
+
+    std::vector<std::pair<std::string, uint64_t>> counters;
+    PerfSample                                    perf;  // counter readings at begin()
+};
+
+inline double process_cpu_ms()
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+// current resident set size from /proc/self/statm, 0 when it cannot be read
+inline int64_t current_rss_kb()
+{
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (fp == NULL) {
+        return 0;
+    }
+    long long size = 0, resident = 0;
+    const bool ok  = fscanf(fp, "%lld %lld", &size, &resident) == 2;
+    fclose(fp);
+    return ok ? resident * (sysconf(_SC_PAGESIZE) / 1024) : 0;
+}
+
+inline int64_t peak_rss_kb()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+class Tracer {
+public:
+    static Tracer& instance()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    void enable(bool on = true)
+    {
+        active = on;
+    }
+
+    bool enabled() const
+    {
+        return active;
+    }
+
+    int begin(const char* name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceEvent                  event;
+        event.name              = name;
+        event.parent            = open.empty() ? -1 : open.back();
+        event.depth             = open.size();
+        event.start_ms          = since_origin_ms();
+        event.cpu_ms            = process_cpu_ms();
+        event.rss_delta_kb       = current_rss_kb();
+        event.peak_rss_growth_kb = peak_rss_kb();
+        event.bytes_allocated    = allocated_bytes().load(std::memory_order_relaxed);
+        if (PerfCounters::instance().enabled()) {
+            event.perf = PerfCounters::instance().read();
+        }
+        events.push_back(std::move(event));
+        open.push_back(events.size() - 1);
+        return open.back();
+    }
+
+    void end(int id)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto&                       event = events[id];
+        event.wall_ms                     = since_origin_ms() - event.start_ms;
+        event.cpu_ms                      = process_cpu_ms() - event.cpu_ms;
+        event.rss_delta_kb                = current_rss_kb() - event.rss_delta_kb;
+        event.peak_rss_growth_kb          = peak_rss_kb() - event.peak_rss_growth_kb;
+        event.bytes_allocated = allocated_bytes().load(std::memory_order_relaxed) - event.bytes_allocated;
+        if (PerfCounters::instance().enabled()) {
+            event.perf = PerfCounters::instance().read() - event.perf;
+            for (int e = 0; e < NumPerfEvents; e++) {
+                if (event.perf.valid[e]) {
+                    event.counters.emplace_back(std::string("perf.") + perf_event_name(e), event.perf.values[e]);
+                }
+            }
+        }
+        if (!open.empty() && open.back() == id) {
+            open.pop_back();
+        }
+    }
+
+    void add_counter(int id, const char* name, uint64_t value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& [key, total] : events[id].counters) {
+            if (key == name) {
+                total += value;
+                return;
+            }
+        }
+        events[id].counters.emplace_back(name, value);
+    }
+
+    // Attach a counter to the innermost open scope (no-op when tracing is off or no scope is open)
+    void add_counter(const char* name, uint64_t value)
+    {
+        int id;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!active || open.empty()) {
+                return;
+            }
+            id = open.back();
+        }
+        add_counter(id, name, value);
+    }
+
+    const std::vector<TraceEvent>& get_events() const
+    {
+        return events;
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.clear();
+        open.clear();
+    }
+
+    // {"events": [{"name", "parent", "depth", "start_ms", "wall_ms", "cpu_ms", ..., "counters": {...}}]}
+    bool write_json(const std::string& filename) const
+    {
+        FILE* fp = fopen(filename.c_str(), "w");
+        if (fp == NULL) {
+            return false;
+        }
+        fprintf(fp, "{\"events\": [\n");
+        for (size_t i = 0; i < events.size(); i++) {
+            const auto& e = events[i];
+            fprintf(fp,
+                    "  {\"name\": \"%s\", \"parent\": %d, \"depth\": %d, \"start_ms\": %.3f, \"wall_ms\": %.3f, "
+                    "\"cpu_ms\": %.3f, \"rss_delta_kb\": %lld, \"peak_rss_growth_kb\": %lld, "
+                    "\"bytes_allocated\": %llu, \"counters\": {",
+                    escape(e.name).c_str(),
+                    e.parent,
+                    e.depth,
+                    e.start_ms,
+                    e.wall_ms,
+                    e.cpu_ms,
+                    (long long)e.rss_delta_kb,
+                    (long long)e.peak_rss_growth_kb,
+                    (unsigned long long)e.bytes_allocated);
+            write_counters(fp, e);
+            fprintf(fp, "}}%s\n", i + 1 < events.size() ? "," : "");
+        }
+        fprintf(fp, "]}\n");
+        fclose(fp);
+        return true;
+    }
+
+    // Chrome trace event format (chrome://tracing, Perfetto): one complete ("X") event per scope
+    bool write_chrome_trace(const std::string& filename) const
+    {
+        FILE* fp = fopen(filename.c_str(), "w");
+        if (fp == NULL) {
+            return false;
+        }
+        fprintf(fp, "{\"traceEvents\": [\n");
+        for (size_t i = 0; i < events.size(); i++) {
+            const auto& e = events[i];
+            fprintf(fp,
+                    "  {\"name\": \"%s\", \"cat\": \"groot\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, "
+                    "\"ts\": %.3f, \"dur\": %.3f, "
+                    "\"args\": {\"cpu_ms\": %.3f, \"rss_delta_kb\": %lld, \"peak_rss_growth_kb\": %lld, "
+                    "\"bytes_allocated\": %llu",
+                    escape(e.name).c_str(),
+                    e.start_ms * 1e3,
+                    e.wall_ms * 1e3,
+                    e.cpu_ms,
+                    (long long)e.rss_delta_kb,
+                    (long long)e.peak_rss_growth_kb,
+                    (unsigned long long)e.bytes_allocated);
+            if (!e.counters.empty()) {
+                fprintf(fp, ", ");
+                write_counters(fp, e);
+            }
+            fprintf(fp, "}}%s\n", i + 1 < events.size() ? "," : "");
+        }
+        fprintf(fp, "], \"displayTimeUnit\": \"ms\"}\n");
+        fclose(fp);
+        return true;
+    }
+
+private:
+    Tracer(): origin(std::chrono::steady_clock::now()) {}
+
+    double since_origin_ms() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    static std::string escape(const std::string& text)
+    {
+        std::string out;
+        for (const char c : text) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+            }
+            out += c;
+        }
+        return out;
+    }
+
+    static void write_counters(FILE* fp, const TraceEvent& e)
+    {
+        for (size_t c = 0; c < e.counters.size(); c++) {
+            fprintf(fp,
+                    "%s\"%s\": %llu",
+                    c ? ", " : "",
+                    escape(e.counters[c].first).c_str(),
+                    (unsigned long long)e.counters[c].second);
+        }
+    }
+
+    bool                                  active{false};
+    std::mutex                            mutex;
+    std::vector<TraceEvent>               events;
+    std::vector<int>                      open;
+    std::chrono::steady_clock::time_point origin;
+};
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name): id(Tracer::instance().enabled() ? Tracer::instance().begin(name) : -1) {}
+
+    ~TraceScope()
+    {
+        if (id >= 0) {
+            Tracer::instance().end(id);
+        }
+    }
+
+    TraceScope(const TraceScope&)            = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    void counter(const char* name, uint64_t value)
+    {
+        if (id >= 0) {
+            Tracer::instance().add_counter(id, name, value);
+        }
+    }
+
+private:
+    int id;
+};
+
+}  // namespace groot
+
+#ifdef GROOT_TRACE_ALLOCATIONS
+// Counting replacements of the global allocation functions (define in one translation unit only). Every form,
+// plain and aligned, sized or not, is backed by malloc/aligned_alloc and released by free. The nothrow forms
+// forward to these in libstdc++ and libc++.
+void* operator new(std::size_t bytes)
+{
+    groot::allocated_bytes().fetch_add(bytes, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(bytes ? bytes : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t bytes)
+{
+    return ::operator new(bytes);
+}
+
+void* operator new(std::size_t bytes, std::align_val_t align)
+{
+    groot::allocated_bytes().fetch_add(bytes, std::memory_order_relaxed);
+    const std::size_t alignment = std::max(std::size_t(align), sizeof(void*));
+    const std::size_t rounded   = (std::max<std::size_t>(bytes, 1) + alignment - 1) / alignment * alignment;
+    if (void* ptr = std::aligned_alloc(alignment, rounded)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t bytes, std::align_val_t align)
+{
+    return ::operator new(bytes, align);
+}
+
+// GCC inlines these into callers whose pointer came from a `new` expression, sees free() on it and reports
+// -Wmismatched-new-delete. The pairing is correct: every operator new above allocates with the malloc family.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif